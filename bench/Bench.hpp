@@ -0,0 +1,207 @@
+#pragma once
+
+#include "FluidSim.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef FLUID_SOURCE_DIR
+#define FLUID_SOURCE_DIR "."
+#endif
+
+namespace Fluid {
+
+// Runs single tick phases of a FluidSim, which befriends this struct.
+struct PhaseAccess {
+    template <typename Sim>
+    static void external_forces(Sim& sim) {
+        sim.apply_external_forces();
+    }
+
+    template <typename Sim>
+    static void p_forces(Sim& sim) {
+        sim.apply_p_forces();
+    }
+
+    template <typename Sim>
+    static void flow(Sim& sim) {
+        sim.make_flow_from_vel();
+    }
+
+    template <typename Sim>
+    static void recalc_p(Sim& sim) {
+        sim.recalc_p();
+    }
+
+    template <typename Sim>
+    static bool step(Sim& sim) {
+        return sim.make_step();
+    }
+
+    // Makes dst continue from the state of src.
+    template <typename Sim>
+    static void copy_state(Sim& dst, const Sim& src) {
+        dst.tick                 = src.tick;
+        dst.UT                   = src.UT;
+        dst.rnd                  = src.rnd;
+        dst.field.data           = src.field.data;
+        dst.p.data               = src.p.data;
+        dst.old_p.data           = src.old_p.data;
+        dst.velocity.v.data      = src.velocity.v.data;
+        dst.velocity_flow.v.data = src.velocity_flow.v.data;
+        dst.last_use.data        = src.last_use.data;
+        dst.geometry             = src.geometry;
+    }
+
+    struct FlowDifference {
+        size_t components = 0;
+        double max        = 0;
+    };
+
+    template <typename Sim>
+    static FlowDifference flow_difference(const Sim& a, const Sim& b) {
+        FlowDifference diff;
+        for (size_t x = 0; x < a.rows; ++x) {
+            for (size_t y = 0; y < a.cols; ++y) {
+                for (size_t d = 0; d < Sim::deltas.size(); ++d) {
+                    auto u = static_cast<double>(a.velocity_flow.get(x, y, d));
+                    auto v = static_cast<double>(b.velocity_flow.get(x, y, d));
+                    if (u != v) {
+                        ++diff.components;
+                        diff.max = std::max(diff.max, std::abs(u - v));
+                    }
+                }
+            }
+        }
+        return diff;
+    }
+
+    template <typename Sim>
+    static void tick(Sim& sim) {
+        sim.apply_external_forces();
+        sim.apply_p_forces();
+        sim.make_flow_from_vel();
+        sim.recalc_p();
+        sim.make_step();
+        ++sim.tick;
+    }
+};
+
+} // namespace Fluid
+
+namespace bench {
+
+inline std::string base_field_path() {
+    return FLUID_SOURCE_DIR "/base_field";
+}
+
+// base_field scaled to rows x cols by nearest neighbour, with a wall border.
+// Written to the temp directory once and reused.
+inline std::string scaled_field(size_t rows, size_t cols) {
+    auto path = std::filesystem::temp_directory_path() /
+                ("fluid_field_" + std::to_string(rows) + "x" + std::to_string(cols));
+    if (std::filesystem::exists(path)) {
+        return path;
+    }
+
+    std::ifstream in{ base_field_path() };
+    std::vector<std::string> base;
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty()) {
+            base.push_back(line);
+        }
+    }
+    if (base.size() < 3) {
+        throw std::runtime_error("Cannot read " + base_field_path());
+    }
+
+    std::ofstream out{ path };
+    for (size_t x = 0; x < rows; ++x) {
+        for (size_t y = 0; y < cols; ++y) {
+            bool border = x == 0 || y == 0 || x + 1 == rows || y + 1 == cols;
+            size_t bx   = 1 + (x - 1) * (base.size() - 2) / (rows - 2);
+            size_t by   = 1 + (y - 1) * (base[0].size() - 2) / (cols - 2);
+            out << (border ? '#' : base[bx][by]);
+        }
+        if (x + 1 < rows) {
+            out << '\n';
+        }
+    }
+    return path;
+}
+
+template <typename F>
+double time_us(F&& func, size_t repeat) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repeat; ++i) {
+        func();
+    }
+    std::chrono::duration<double, std::micro> spent =
+        std::chrono::steady_clock::now() - start;
+    return spent.count() / repeat;
+}
+
+// Hardware cache-miss counter of the calling thread. Unavailable without
+// perf_event access (containers, perf_event_paranoid > 2).
+class CacheMisses {
+  public:
+    CacheMisses() {
+        perf_event_attr attr{};
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.size           = sizeof(attr);
+        attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    CacheMisses(const CacheMisses&)            = delete;
+    CacheMisses& operator=(const CacheMisses&) = delete;
+
+    ~CacheMisses() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool available() const {
+        return fd >= 0;
+    }
+
+    // Misses per call of func, if the counter is available.
+    template <typename F>
+    std::optional<double> per_call(F&& func, size_t repeat) {
+        if (fd < 0) {
+            return std::nullopt;
+        }
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        for (size_t i = 0; i < repeat; ++i) {
+            func();
+        }
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+            return std::nullopt;
+        }
+        return static_cast<double>(count) / repeat;
+    }
+
+  private:
+    int fd = -1;
+};
+
+} // namespace bench
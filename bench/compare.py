@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Compares a fluid_bench report with a baseline report.
+
+    bench/compare.py baseline.json current.json [--threshold=5]
+
+Configurations are matched by field, types, size and thread count. A
+configuration whose ticks/s dropped by more than the threshold (percent) is
+a regression, and so is one that failed or disappeared; the exit status is
+1 if there is any.
+"""
+
+import json
+import sys
+
+
+def key(result):
+    return (result["field"], result["p_type"], result["v_type"],
+            result["v_flow_type"], result["size"], result["threads"])
+
+
+def describe(k):
+    field, p, v, vf, size, threads = k
+    return f"{field} {p}/{v}/{vf} {size} x{threads}"
+
+
+def main(argv):
+    threshold = 5.0
+    paths = []
+    for arg in argv[1:]:
+        if arg.startswith("--threshold="):
+            threshold = float(arg.split("=", 1)[1])
+        else:
+            paths.append(arg)
+    if len(paths) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    with open(paths[0]) as f:
+        baseline = {key(r): r for r in json.load(f)["results"]}
+    with open(paths[1]) as f:
+        current = {key(r): r for r in json.load(f)["results"]}
+
+    regressions = 0
+    for k, base in sorted(baseline.items()):
+        now = current.get(k)
+        if now is None:
+            print(f"MISSING   {describe(k)}")
+            regressions += 1
+            continue
+        if "error" in now:
+            print(f"FAILED    {describe(k)}: {now['error']}")
+            regressions += 1
+            continue
+        if "error" in base:
+            continue
+        change = (now["ticks_per_second"] / base["ticks_per_second"] - 1) * 100
+        rss = now["peak_rss_kb"] - base["peak_rss_kb"]
+        status = "ok"
+        if change < -threshold:
+            status = "REGRESSED"
+            regressions += 1
+        elif change > threshold:
+            status = "improved"
+        print(f"{status:<9} {describe(k)}: {base['ticks_per_second']:.1f} -> "
+              f"{now['ticks_per_second']:.1f} ticks/s ({change:+.1f}%), "
+              f"{now['ns_per_cell_tick']:.1f} ns/cell/tick, "
+              f"peak RSS {rss:+d} KB")
+    for k in sorted(current.keys() - baseline.keys()):
+        print(f"new       {describe(k)}")
+
+    print(f"{regressions} regression(s) past {threshold}%")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
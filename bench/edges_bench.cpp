@@ -0,0 +1,86 @@
+#include "ConcurentVector.h"
+#include "SegmentedBuffer.hpp"
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Seam cell collection of the flow phase: threads append cells during a
+// sweep, then the calling thread gathers them. The shared ConcurrentVector
+// against one SegmentedBuffer per thread, merged after the sweep.
+
+namespace {
+
+using Point = std::pair<size_t, size_t>;
+
+constexpr size_t SWEEPS    = 50;
+constexpr size_t PER_SWEEP = 1 << 16;
+
+struct alignas(64) Buffer {
+    Fluid::SegmentedBuffer<Point> points;
+};
+
+// Runs SWEEPS rounds of `push(thread, i)` for PER_SWEEP points split over the
+// threads, each followed by `gather()` on the calling thread. Returns
+// million points per second.
+template <typename Push, typename Gather>
+double sweeps(size_t threads, Push&& push, Gather&& gather) {
+    std::barrier start{ static_cast<ptrdiff_t>(threads + 1) };
+    std::barrier done{ static_cast<ptrdiff_t>(threads + 1) };
+    std::vector<std::jthread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t s = 0; s < SWEEPS; ++s) {
+                start.arrive_and_wait();
+                for (size_t i = t; i < PER_SWEEP; i += threads) {
+                    push(t, i);
+                }
+                done.arrive_and_wait();
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < SWEEPS; ++s) {
+        start.arrive_and_wait();
+        done.arrive_and_wait();
+        gather();
+    }
+    std::chrono::duration<double> spent = std::chrono::steady_clock::now() - begin;
+    return SWEEPS * PER_SWEEP / spent.count() / 1e6;
+}
+
+} // namespace
+
+int main() {
+    std::printf("%u hardware threads, %zu points per sweep, %zu sweeps\n",
+                std::thread::hardware_concurrency(), PER_SWEEP, SWEEPS);
+    std::vector<Point> merged;
+    for (size_t threads : { 1, 2, 4, 8, 16, 32, 64 }) {
+        ConcurrentVector<Point> shared;
+        double concurrent = sweeps(
+            threads, [&](size_t, size_t i) { shared.emplace_back(i, i); },
+            [&] {
+                merged.assign(shared.begin(), shared.end());
+                shared.clear();
+            });
+
+        std::vector<Buffer> buffers(threads);
+        double segmented = sweeps(
+            threads, [&](size_t t, size_t i) { buffers[t].points.emplace_back(i, i); },
+            [&] {
+                merged.clear();
+                for (auto&& b : buffers) {
+                    b.points.append_to(merged);
+                    b.points.clear();
+                }
+            });
+
+        std::printf("%2zu threads: ConcurrentVector %7.1f Mpts/s, per-thread "
+                    "SegmentedBuffer %7.1f Mpts/s\n",
+                    threads, concurrent, segmented);
+    }
+}
@@ -0,0 +1,59 @@
+#include "Bench.hpp"
+#include <cstdio>
+#include <memory>
+
+// Regression harness of the flow solvers. Every tick both solvers start
+// from the state reached by the reference (unit) solver; the harness
+// compares the velocity_flow they produce, their sweep counts and time.
+
+namespace {
+
+using Type = Fluid::Fixed<32, 16, true>;
+using Sim  = Fluid::FluidSim<Type, Type, Type>;
+using Fluid::PhaseAccess;
+
+constexpr size_t TICKS = 100;
+
+void run(size_t rows, size_t cols, const std::string& path) {
+    auto unit       = std::make_unique<Sim>(rows, cols);
+    auto saturating = std::make_unique<Sim>(rows, cols);
+    unit->read_field(path);
+    saturating->read_field(path);
+    saturating->set_flow_solver(Fluid::FlowSolver::SATURATING);
+
+    double unit_us = 0, saturating_us = 0;
+    size_t same_ticks = 0, components = 0;
+    double max_diff   = 0;
+    for (size_t i = 0; i < TICKS; ++i) {
+        PhaseAccess::copy_state(*saturating, *unit);
+        for (auto* sim : { unit.get(), saturating.get() }) {
+            PhaseAccess::external_forces(*sim);
+            PhaseAccess::p_forces(*sim);
+        }
+        unit_us += bench::time_us([&] { PhaseAccess::flow(*unit); }, 1);
+        saturating_us += bench::time_us([&] { PhaseAccess::flow(*saturating); }, 1);
+
+        auto diff = PhaseAccess::flow_difference(*unit, *saturating);
+        same_ticks += diff.components == 0;
+        components += diff.components;
+        max_diff = std::max(max_diff, diff.max);
+
+        PhaseAccess::recalc_p(*unit);
+        PhaseAccess::step(*unit);
+    }
+
+    std::printf("%5zux%-5zu sweeps %6zu -> %-6zu time %9.0f -> %-9.0f us  "
+                "identical ticks %3zu/%zu, differing components %zu, max diff %g\n",
+                rows, cols, unit->flow_sweeps(), saturating->flow_sweeps(), unit_us,
+                saturating_us, same_ticks, TICKS, components, max_diff);
+}
+
+} // namespace
+
+int main() {
+    std::printf("Flow solvers over %zu ticks: unit -> saturating.\n", TICKS);
+    run(36, 84, bench::base_field_path());
+    for (auto [rows, cols] : { std::pair<size_t, size_t>{ 50, 150 }, { 100, 300 } }) {
+        run(rows, cols, bench::scaled_field(rows, cols));
+    }
+}
@@ -0,0 +1,253 @@
+#include "Bench.hpp"
+#include "Mapping.hpp"
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <tuple>
+
+// Whole-simulation throughput over a fixed matrix: base_field and base_field
+// scaled up to 1000x3000, every type triple of TYPES, the dynamic size and
+// the matching size of SIZES, and 1, 2, 4, ... up to --threads workers. Each
+// configuration runs a fixed number of ticks with a fixed seed in a child
+// process of its own, so its peak RSS is its own. Results go to --out as
+// JSON; bench/compare.py checks them against a baseline. With --repeat
+// every configuration runs that many times and the fastest run is kept.
+//
+//   fluid_bench [--ticks=20] [--seed=1337] [--threads=N] [--max-cells=N]
+//               [--repeat=1] [--out=fluid_bench.json]
+
+namespace {
+
+using Types = std::tuple<TYPES>;
+using Sizes = std::tuple<SIZES>;
+
+constexpr size_t WARMUP_TICKS = 2;
+
+struct Options {
+    size_t ticks     = 20;
+    uint64_t seed    = 1337;
+    size_t threads   = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t max_cells = 1000 * 3000;
+    size_t repeat    = 1;
+    std::string out  = "fluid_bench.json";
+};
+
+struct Field {
+    size_t rows;
+    size_t cols;
+    std::string path;
+};
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto eq         = arg.find('=');
+        auto key        = arg.substr(0, eq);
+        auto value      = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (key == "--ticks") {
+                options.ticks = std::stoul(value);
+            } else if (key == "--seed") {
+                options.seed = std::stoull(value);
+            } else if (key == "--threads") {
+                options.threads = std::max<size_t>(std::stoul(value), 1);
+            } else if (key == "--max-cells") {
+                options.max_cells = std::stoul(value);
+            } else if (key == "--repeat") {
+                options.repeat = std::max<size_t>(std::stoul(value), 1);
+            } else if (key == "--out") {
+                options.out = value;
+            } else {
+                throw std::invalid_argument{ arg };
+            }
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Unknown or bad option: " + arg);
+        }
+    }
+    return options;
+}
+
+std::vector<size_t> thread_counts(size_t max) {
+    std::vector<size_t> counts;
+    for (size_t n = 1; n < max; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(max);
+    return counts;
+}
+
+template <typename P, typename V, typename VF, typename Size>
+nlohmann::json run(const Field& field, size_t threads, const Options& options) {
+    using Sim = Fluid::FluidSim<P, V, VF, Size>;
+    auto sim  = std::make_unique<Sim>(field.rows, field.cols, threads);
+    sim->read_field(field.path);
+    sim->set_seed(options.seed);
+
+    // Frames are formatted as in a real run but go nowhere.
+    std::ostream frames{ nullptr };
+    sim->set_tick_limit(WARMUP_TICKS);
+    sim->run(frames);
+    sim->set_tick_limit(WARMUP_TICKS + options.ticks);
+    auto start = std::chrono::steady_clock::now();
+    sim->run(frames);
+    std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+
+    double cells = static_cast<double>(field.rows * field.cols);
+    return { { "seconds", spent.count() },
+             { "ticks_per_second", options.ticks / spent.count() },
+             { "ns_per_cell_tick", spent.count() * 1e9 / (cells * options.ticks) } };
+}
+
+// Runs func in a child process and returns what it printed as JSON, with
+// the child's peak RSS added.
+template <typename F>
+nlohmann::json run_isolated(F&& func) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("pipe failed");
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("fork failed");
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        // The simulation reports its size on stdout.
+        std::freopen("/dev/null", "w", stdout);
+        std::string text;
+        try {
+            text = func().dump();
+        } catch (const std::exception& e) {
+            text = nlohmann::json{ { "error", e.what() } }.dump();
+        }
+        for (size_t done = 0; done < text.size();) {
+            ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+            if (n <= 0) {
+                _exit(1);
+            }
+            done += n;
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string text;
+    char buf[4096];
+    for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) > 0;) {
+        text.append(buf, n);
+    }
+    close(fds[0]);
+
+    int status = 0;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || text.empty()) {
+        return { { "error", "child exited abnormally" } };
+    }
+    auto result           = nlohmann::json::parse(text);
+    result["peak_rss_kb"] = usage.ru_maxrss;
+    return result;
+}
+
+template <typename F>
+void for_each_triple(F&& func) {
+    constexpr size_t n = std::tuple_size_v<Types>;
+    [&]<size_t... i>(std::index_sequence<i...>) {
+        (func.template operator()<std::tuple_element_t<i / (n * n), Types>,
+                                  std::tuple_element_t<i / n % n, Types>,
+                                  std::tuple_element_t<i % n, Types>>(
+             types_names[i / (n * n)], types_names[i / n % n], types_names[i % n]),
+         ...);
+    }(std::make_index_sequence<n * n * n>{});
+}
+
+// Calls func with the dynamic size and with every size of SIZES that
+// matches the field.
+template <typename F>
+void for_each_size(const Field& field, F&& func) {
+    func.template operator()<Fluid::StaticSize<0, 0>>();
+    [&]<size_t... i>(std::index_sequence<i...>) {
+        (
+            [&] {
+                using Size = std::tuple_element_t<i, Sizes>;
+                if (Fluid::is_static<Size> && Size::rows == field.rows &&
+                    Size::cols == field.cols) {
+                    func.template operator()<Size>();
+                }
+            }(),
+            ...);
+    }(std::make_index_sequence<std::tuple_size_v<Sizes>>{});
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    std::vector<Field> fields{ { 36, 84, bench::base_field_path() } };
+    for (auto [rows, cols] : { std::pair<size_t, size_t>{ 100, 300 },
+                               { 400, 1200 },
+                               { 1000, 3000 } }) {
+        if (rows * cols <= options.max_cells) {
+            fields.push_back({ rows, cols, bench::scaled_field(rows, cols) });
+        }
+    }
+
+    nlohmann::json report;
+    report["ticks"]            = options.ticks;
+    report["seed"]             = options.seed;
+    report["repeat"]           = options.repeat;
+    report["hardware_threads"] = std::thread::hardware_concurrency();
+    report["results"]          = nlohmann::json::array();
+
+    for (auto&& field : fields) {
+        for_each_triple([&]<typename P, typename V, typename VF>(
+                            std::string_view p, std::string_view v,
+                            std::string_view vf) {
+            for_each_size(field, [&]<typename Size>() {
+                for (size_t threads : thread_counts(options.threads)) {
+                    nlohmann::json result;
+                    for (size_t r = 0; r < options.repeat; ++r) {
+                        auto next = run_isolated([&] {
+                            return run<P, V, VF, Size>(field, threads, options);
+                        });
+                        if (result.is_null() || next.contains("error") ||
+                            (!result.contains("error") &&
+                             next["seconds"] < result["seconds"])) {
+                            result = std::move(next);
+                        }
+                    }
+                    result["field"] = std::to_string(field.rows) + "x" +
+                                      std::to_string(field.cols);
+                    result["p_type"]      = p;
+                    result["v_type"]      = v;
+                    result["v_flow_type"] = vf;
+                    result["size"] = Fluid::is_static<Size> ? "static" : "dynamic";
+                    result["threads"] = threads;
+                    std::cout << result.dump() << std::endl;
+                    report["results"].push_back(std::move(result));
+                }
+            });
+        });
+    }
+
+    std::ofstream out{ options.out };
+    out << report.dump(2) << '\n';
+    if (!out.flush()) {
+        std::cerr << "Failed to write " << options.out << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "Bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+// Time and cache misses per call of every tick phase, AoS against SoA, for
+// base_field (dynamic size) and every size in SIZES (static and dynamic).
+// Fields of other sizes are base_field scaled up.
+
+#define S(x, y) Fluid::StaticSize<x, y>
+
+namespace {
+
+using Type = Fluid::Fixed<32, 16, true>;
+using Fluid::PhaseAccess;
+
+std::string misses(std::optional<double> value) {
+    if (!value) {
+        return "n/a";
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.0f", *value);
+    return buf;
+}
+
+template <typename Size, typename Layout>
+void run(const char* layout, size_t rows, size_t cols, const std::string& path) {
+    using Sim = Fluid::FluidSim<Type, Type, Type, Size, Layout>;
+    auto sim  = std::make_unique<Sim>(rows, cols);
+    sim->read_field(path);
+    for (size_t i = 0; i < 5; ++i) {
+        PhaseAccess::tick(*sim);
+    }
+
+    // Roughly the same amount of work per phase whatever the field size.
+    auto repeat = [&](size_t calls) {
+        return std::max<size_t>(3, calls * 36 * 84 / (rows * cols));
+    };
+    bench::CacheMisses counter;
+    std::printf("%5zux%-5zu %-7s %-4s", rows, cols,
+                Fluid::is_static<Size> ? "static" : "dynamic", layout);
+    auto phase = [&](const char* name, auto&& func, size_t calls) {
+        double us = bench::time_us(func, repeat(calls));
+        auto miss = counter.per_call(func, repeat(calls));
+        std::printf("  %s %9.1f us %8s", name, us, misses(miss).c_str());
+    };
+    phase("ext", [&] { PhaseAccess::external_forces(*sim); }, 2000);
+    phase("p_forces", [&] { PhaseAccess::p_forces(*sim); }, 500);
+    phase("flow", [&] { PhaseAccess::flow(*sim); }, 20);
+    phase("recalc", [&] { PhaseAccess::recalc_p(*sim); }, 500);
+    phase("step", [&] { PhaseAccess::step(*sim); }, 50);
+    std::printf("\n");
+}
+
+template <typename Size>
+void run_layouts(size_t rows, size_t cols, const std::string& path) {
+    run<Size, Fluid::AoS>("AoS", rows, cols, path);
+    run<Size, Fluid::SoA<>>("SoA", rows, cols, path);
+}
+
+template <typename... Sizes>
+void run_sizes() {
+    (
+        [] {
+            auto path = bench::scaled_field(Sizes::rows, Sizes::cols);
+            run_layouts<Sizes>(Sizes::rows, Sizes::cols, path);
+            run_layouts<Fluid::StaticSize<0, 0>>(Sizes::rows, Sizes::cols, path);
+        }(),
+        ...);
+}
+
+} // namespace
+
+int main() {
+    std::printf("Columns: phase, time per call, cache misses per call.\n");
+    if (!bench::CacheMisses{}.available()) {
+        std::printf("Cache-miss counter unavailable (perf_event_open failed).\n");
+    }
+    run_layouts<Fluid::StaticSize<0, 0>>(36, 84, bench::base_field_path());
+    run_sizes<SIZES>();
+}
@@ -0,0 +1,79 @@
+#include "Bench.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <memory>
+
+// Time per call of the vectorised phases (apply_external_forces, recalc_p)
+// for every supported instruction set, against the AoS scalar code, on
+// base_field scaled to 100x300.
+
+namespace {
+
+using Fluid::PhaseAccess;
+
+constexpr size_t ROWS = 100;
+constexpr size_t COLS = 300;
+
+const char* isa_name(Fluid::simd::Isa isa) {
+    switch (isa) {
+    case Fluid::simd::Isa::AVX2:
+        return "avx2";
+    case Fluid::simd::Isa::SSE4:
+        return "sse4";
+    default:
+        return "scalar";
+    }
+}
+
+template <typename F>
+double best_us(F&& func, size_t repeat) {
+    double best = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < 5; ++i) {
+        best = std::min(best, bench::time_us(func, repeat));
+    }
+    return best;
+}
+
+template <typename T, typename Layout>
+void run(const char* type, const char* layout, const std::string& path) {
+    using Sim = Fluid::FluidSim<T, T, T, Fluid::StaticSize<0, 0>, Layout>;
+    auto sim  = std::make_unique<Sim>(ROWS, COLS);
+    sim->read_field(path);
+    for (size_t i = 0; i < 3; ++i) {
+        PhaseAccess::tick(*sim);
+    }
+
+    for (auto isa : { Fluid::simd::Isa::SCALAR, Fluid::simd::Isa::SSE4,
+                      Fluid::simd::Isa::AVX2 }) {
+        if (isa > Fluid::simd::best_isa()) {
+            break;
+        }
+        Fluid::simd::set_isa(isa);
+        double ext    = best_us([&] { PhaseAccess::external_forces(*sim); }, 200);
+        double recalc = best_us([&] { PhaseAccess::recalc_p(*sim); }, 100);
+        std::printf("%-8s %-4s %-7s ext %8.1f us  recalc %8.1f us\n", type, layout,
+                    Layout::planar ? isa_name(isa) : "-", ext, recalc);
+        // The AoS layout never reaches the kernels.
+        if (!Layout::planar) {
+            break;
+        }
+    }
+    Fluid::simd::set_isa(Fluid::simd::best_isa());
+}
+
+template <typename T>
+void run_layouts(const char* type, const std::string& path) {
+    run<T, Fluid::AoS>(type, "AoS", path);
+    run<T, Fluid::SoA<>>(type, "SoA", path);
+}
+
+} // namespace
+
+int main() {
+    auto path = bench::scaled_field(ROWS, COLS);
+    run_layouts<Fluid::Fixed<32, 16, true>>("FF32", path);
+    run_layouts<double>("double", path);
+    run_layouts<float>("float", path);
+}
@@ -0,0 +1,109 @@
+# One translation unit per FluidSim specialization, plus the dispatch table
+# main.cpp looks them up in (FluidInstances.hpp).
+#
+# FLUID_INSTANCES lists "P/V/VF" or "P/V/VF/S(rows,cols)" entries separated
+# by ';'. Every listed triple gets a dynamic-size instance; an entry with a
+# size also gets that static one. Without FLUID_INSTANCES every combination
+# of TYPES is built, with the dynamic size and every size of SIZES.
+
+set(FLUID_TYPE_REGEX "DOUBLE|FLOAT|FIXED\\([0-9]+,[0-9]+\\)|FAST_FIXED\\([0-9]+,[0-9]+\\)")
+set(FLUID_SIZE_REGEX "S\\([0-9]+,[0-9]+\\)")
+
+function(fluid_instance_entries out)
+    set(entries)
+    if(FLUID_INSTANCES)
+        foreach(item IN LISTS FLUID_INSTANCES)
+            string(REPLACE " " "" item "${item}")
+            string(REPLACE "/" ";" parts "${item}")
+            list(LENGTH parts count)
+            if(NOT (count EQUAL 3 OR count EQUAL 4))
+                message(FATAL_ERROR "FLUID_INSTANCES: expected P/V/VF[/S(r,c)], got ${item}")
+            endif()
+            list(SUBLIST parts 0 3 triple)
+            list(JOIN triple "/" triple)
+            list(APPEND entries "${triple}/")
+            if(count EQUAL 4)
+                list(GET parts 3 size)
+                list(APPEND entries "${triple}/${size}")
+            endif()
+        endforeach()
+    else()
+        string(REPLACE " " "" types "${TYPES}")
+        string(REPLACE " " "" sizes "${SIZES}")
+        string(REGEX MATCHALL "${FLUID_TYPE_REGEX}" types "${types}")
+        string(REGEX MATCHALL "${FLUID_SIZE_REGEX}" sizes "${sizes}")
+        foreach(p IN LISTS types)
+            foreach(v IN LISTS types)
+                foreach(vf IN LISTS types)
+                    list(APPEND entries "${p}/${v}/${vf}/")
+                    foreach(size IN LISTS sizes)
+                        list(APPEND entries "${p}/${v}/${vf}/${size}")
+                    endforeach()
+                endforeach()
+            endforeach()
+        endforeach()
+    endif()
+    list(REMOVE_DUPLICATES entries)
+    set(${out} "${entries}" PARENT_SCOPE)
+endfunction()
+
+# Adds the instance sources and the table to `target` and turns the table on.
+function(fluid_add_instances target)
+    fluid_instance_entries(entries)
+    set(dir "${CMAKE_CURRENT_BINARY_DIR}/instances")
+    set(externs "")
+    set(table "")
+    set(index 0)
+    foreach(entry IN LISTS entries)
+        string(REPLACE "/" ";" parts "${entry}")
+        list(GET parts 0 p)
+        list(GET parts 1 v)
+        list(GET parts 2 vf)
+        list(GET parts 3 size)
+        foreach(type IN ITEMS "${p}" "${v}" "${vf}")
+            if(NOT type MATCHES "^(${FLUID_TYPE_REGEX})$")
+                message(FATAL_ERROR "Unknown type in ${entry}: ${type}")
+            endif()
+        endforeach()
+        if(size STREQUAL "")
+            set(size_type "Fluid::StaticSize<0, 0>")
+        elseif(size MATCHES "^${FLUID_SIZE_REGEX}$")
+            set(size_type "${size}")
+        else()
+            message(FATAL_ERROR "Unknown size in ${entry}: ${size}")
+        endif()
+
+        set(sim "Fluid::FluidSim<${p}, ${v}, ${vf}, ${size_type}>")
+        file(CONFIGURE OUTPUT "${dir}/instance_${index}.cpp" CONTENT
+"// ${entry}, generated by cmake/Instances.cmake.
+#include \"Run.hpp\"
+
+template int run_instance<${sim}>(const Parsed&, const Mapper&);
+" @ONLY)
+        target_sources(${target} PRIVATE "${dir}/instance_${index}.cpp")
+
+        string(APPEND externs
+               "extern template int run_instance<${sim}>(const Parsed&, const Mapper&);\n")
+        string(APPEND table "    { Fluid::instance_key(\"${p}\", \"${v}\", \"${vf}\", \"${size}\"),\n"
+               "      \"${p}\", \"${v}\", \"${vf}\", \"${size}\", &run_instance<${sim}> },\n")
+        math(EXPR index "${index} + 1")
+    endforeach()
+
+    file(CONFIGURE OUTPUT "${dir}/FluidInstances.hpp" CONTENT
+"// Generated by cmake/Instances.cmake.
+#pragma once
+
+#include \"Dispatch.hpp\"
+#include \"Run.hpp\"
+
+${externs}
+using InstanceRun = int (*)(const Parsed&, const Mapper&);
+
+inline constexpr std::array<Fluid::InstanceEntry<InstanceRun>, ${index}> instance_table{ {
+${table}} };
+static_assert(Fluid::unique_keys(instance_table));
+" @ONLY)
+    target_include_directories(${target} PRIVATE "${dir}")
+    target_compile_definitions(${target} PRIVATE FLUID_INSTANCE_TABLE)
+    message(STATUS "FluidSim instances: ${index}")
+endfunction()
@@ -1,17 +1,80 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
 #include <type_traits>
 #include <vector>
-#include <array>
 
 namespace Fluid {
 template <typename T>
 constexpr bool is_static = (T::value > 0);
 
-template <typename T, typename Size>
+template <typename T, size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T), std::align_val_t{ Align }));
+    }
+
+    void deallocate(T* ptr, size_t) {
+        ::operator delete(ptr, std::align_val_t{ Align });
+    }
+
+    bool operator==(const AlignedAllocator&) const = default;
+};
+
+// Plain row-major storage, row i starts at i * cols.
+struct RowMajor {
+    static constexpr size_t alignment = 0;
+
+    template <typename T>
+    static constexpr size_t stride(size_t cols) {
+        return cols;
+    }
+};
+
+// Row-major storage where every row starts on an Align-byte boundary.
+template <size_t Align = 64>
+struct PaddedRows {
+    static constexpr size_t alignment = Align;
+
+    template <typename T>
+    static constexpr size_t stride(size_t cols) {
+        if constexpr (Align % sizeof(T) != 0) {
+            return cols;
+        } else {
+            constexpr size_t per_line = Align / sizeof(T);
+            return (cols + per_line - 1) / per_line * per_line;
+        }
+    }
+};
+
+template <typename T, typename Size, typename Layout = RowMajor>
 struct Array2d {
-    using Arr_t = std::conditional_t<is_static<Size>, std::array<T, Size::value>,
-                                     std::vector<T>>;
+    static constexpr size_t static_stride = Layout::template stride<T>(Size::cols);
+
+    using Alloc = std::conditional_t<(Layout::alignment > 0),
+                                     AlignedAllocator<T, Layout::alignment>,
+                                     std::allocator<T>>;
+    using Arr_t =
+        std::conditional_t<is_static<Size>,
+                           std::array<T, Size::rows * static_stride>,
+                           std::vector<T, Alloc>>;
 
   public:
     Array2d(size_t, size_t)
@@ -21,30 +84,63 @@ struct Array2d {
     Array2d(size_t rows, size_t cols)
         requires(!is_static<Size>)
         : rows(rows),
-          cols(cols) {
-        data.resize(rows * cols, T{});
+          cols(cols),
+          stride(Layout::template stride<T>(cols)) {
+        data.resize(rows * stride, T{});
     }
 
     T& operator()(size_t i, size_t j)
         requires is_static<Size>
     {
-        return data[i * Size::cols + j];
+        return data[i * static_stride + j];
     }
 
     T& operator()(size_t i, size_t j)
         requires(!is_static<Size>)
     {
-        return data[i * cols + j];
+        return data[i * stride + j];
+    }
+
+    const T& operator()(size_t i, size_t j) const
+        requires is_static<Size>
+    {
+        return data[i * static_stride + j];
+    }
+
+    const T& operator()(size_t i, size_t j) const
+        requires(!is_static<Size>)
+    {
+        return data[i * stride + j];
+    }
+
+    // Linear offset of (i + dx, j + dy) from (i, j) in `data`.
+    static constexpr ptrdiff_t static_offset(int dx, int dy)
+        requires is_static<Size>
+    {
+        return dx * static_cast<ptrdiff_t>(static_stride) + dy;
+    }
+
+    size_t index(size_t i, size_t j) const {
+        return i * row_stride() + j;
+    }
+
+    size_t row_stride() const {
+        if constexpr (is_static<Size>) {
+            return static_stride;
+        } else {
+            return stride;
+        }
     }
 
     void clear() {
         std::fill(data.begin(), data.end(), T{});
     }
 
-    Arr_t data{};
+    alignas(std::max<size_t>(Layout::alignment, alignof(T))) Arr_t data{};
 
   private:
     size_t rows;
     size_t cols;
+    size_t stride;
 };
-}
\ No newline at end of file
+}
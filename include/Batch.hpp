@@ -0,0 +1,254 @@
+#pragma once
+
+#include "FluidSim.hpp"
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Fluid {
+
+// One run of a parameter sweep. Unset values keep the simulation defaults.
+struct Scenario {
+    std::string name;
+    std::optional<size_t> ticks;
+    std::optional<double> g;
+    std::vector<std::pair<char, double>> rho;
+    std::optional<uint64_t> seed;
+    RngMode rng_mode       = RngMode::MT19937;
+    FlowSolver flow_solver = FlowSolver::UNIT;
+    double rest_threshold  = 0;
+    FrameOutput output;
+};
+
+// A field and the scenarios to run on it, read from a JSON manifest:
+//
+//   { "p_type": "FAST_FIXED(32,16)", "v_type": ..., "v_flow_type": ...,
+//     "field_path": "base_field", "output_dir": "sweep", "ticks": 1000,
+//     "scenarios": [ { "name": "g002", "g": 0.02, "seed": 7,
+//                      "rho": { ".": 800 }, "rng_mode": "counter",
+//                      "flow_solver": "saturating", "rest_threshold": 0.01,
+//                      "output": "every-10", "ticks": 500 }, ... ] }
+//
+// Relative paths are taken from the manifest's directory. Scenario keys
+// other than "name" are optional; "ticks" at the top level applies to the
+// scenarios that do not set it.
+struct Manifest {
+    std::string p_type;
+    std::string v_type;
+    std::string v_flow_type;
+    std::string field_path;
+    std::filesystem::path output_dir;
+    std::vector<Scenario> scenarios;
+
+    // `defaults` supplies the settings a scenario leaves out.
+    static Manifest read(const std::string& path, const Scenario& defaults) {
+        std::ifstream file{ path };
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Cannot open manifest " + path);
+        }
+
+        try {
+            auto json = nlohmann::json::parse(file);
+            auto base = std::filesystem::path{ path }.parent_path();
+
+            Manifest manifest;
+            manifest.p_type      = json.at("p_type").get<std::string>();
+            manifest.v_type      = json.at("v_type").get<std::string>();
+            manifest.v_flow_type = json.at("v_flow_type").get<std::string>();
+            manifest.field_path =
+                (base / json.at("field_path").get<std::string>()).string();
+            manifest.output_dir = base / json.value("output_dir", "batch_out");
+
+            std::optional<size_t> ticks = defaults.ticks;
+            if (json.contains("ticks")) {
+                ticks = json["ticks"].get<size_t>();
+            }
+
+            std::set<std::string> names;
+            for (auto&& item : json.at("scenarios")) {
+                Scenario s = defaults;
+                s.name     = item.at("name").get<std::string>();
+                s.ticks    = ticks;
+                if (!valid_name(s.name) || !names.insert(s.name).second) {
+                    throw std::runtime_error(
+                        "Error: Bad or repeated scenario name: " + s.name);
+                }
+                if (item.contains("ticks")) {
+                    s.ticks = item["ticks"].get<size_t>();
+                }
+                if (item.contains("g")) {
+                    s.g = item["g"].get<double>();
+                }
+                if (item.contains("seed")) {
+                    s.seed = item["seed"].get<uint64_t>();
+                }
+                if (item.contains("rho")) {
+                    for (auto&& [cell, value] : item["rho"].items()) {
+                        if (cell.size() != 1) {
+                            throw std::runtime_error(
+                                "Error: rho keys are single cells, got " + cell);
+                        }
+                        s.rho.emplace_back(cell[0], value.get<double>());
+                    }
+                }
+                if (item.contains("rng_mode")) {
+                    s.rng_mode = parse_rng_mode(item["rng_mode"].get<std::string>());
+                }
+                if (item.contains("flow_solver")) {
+                    s.flow_solver =
+                        parse_flow_solver(item["flow_solver"].get<std::string>());
+                }
+                if (item.contains("output")) {
+                    s.output = parse_frame_output(item["output"].get<std::string>());
+                }
+                if (item.contains("rest_threshold")) {
+                    s.rest_threshold = item["rest_threshold"].get<double>();
+                    if (s.rest_threshold < 0) {
+                        throw std::runtime_error(
+                            "Error: rest_threshold must not be negative");
+                    }
+                }
+                manifest.scenarios.push_back(std::move(s));
+            }
+            if (manifest.scenarios.empty()) {
+                throw std::runtime_error("Error: The manifest has no scenarios");
+            }
+            return manifest;
+        } catch (const nlohmann::json::exception& e) {
+            throw std::runtime_error("Error: Bad manifest " + path + ": " +
+                                     e.what());
+        }
+    }
+
+  private:
+    // Names become file names.
+    static bool valid_name(const std::string& name) {
+        return !name.empty() && name[0] != '.' &&
+               std::all_of(name.begin(), name.end(), [](char c) {
+                   return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+                          c == '-' || c == '.';
+               });
+    }
+};
+
+struct ScenarioResult {
+    std::string name;
+    size_t ticks = 0;
+    std::chrono::steady_clock::duration time{};
+    std::string error;
+};
+
+struct BatchResult {
+    std::vector<ScenarioResult> scenarios;
+    std::chrono::steady_clock::duration time{};
+
+    size_t ticks() const {
+        return std::accumulate(scenarios.begin(), scenarios.end(), size_t{ 0 },
+                               [](size_t sum, const ScenarioResult& r) {
+                                   return sum + r.ticks;
+                               });
+    }
+
+    // Ticks of all scenarios per second of wall time.
+    double ticks_per_second() const {
+        return ticks() / std::chrono::duration<double>(time).count();
+    }
+};
+
+// Runs every scenario of `manifest` on a field of rows x cols. The field is
+// read once; each scenario starts from a copy of it and shares its geometry.
+// Scenarios run whole and single-threaded, one per worker, so no phase ever
+// waits for another thread: the longest go first and every worker takes the
+// next one as soon as it is free. Each scenario writes its frames and stats
+// to <output_dir>/<name>.txt.
+template <typename Sim>
+BatchResult run_batch(const Manifest& manifest, size_t rows, size_t cols,
+                      size_t workers, WorkerPool& pool = WorkerPool::shared()) {
+    Sim origin(rows, cols);
+    origin.read_field(manifest.field_path);
+    std::filesystem::create_directories(manifest.output_dir);
+
+    auto&& scenarios = manifest.scenarios;
+    std::vector<size_t> order(scenarios.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return scenarios[a].ticks.value_or(0) > scenarios[b].ticks.value_or(0);
+    });
+
+    BatchResult batch;
+    batch.scenarios.resize(scenarios.size());
+    std::atomic<size_t> next{ 0 };
+
+    auto run_one = [&](const Scenario& s, ScenarioResult& result) {
+        auto path = manifest.output_dir / (s.name + ".txt");
+        std::ofstream out{ path };
+        if (!out.is_open()) {
+            throw std::runtime_error("Cannot open " + path.string() +
+                                     " for writing");
+        }
+
+        Sim sim(rows, cols);
+        sim.start_from(origin);
+        if (s.ticks.has_value()) {
+            sim.set_tick_limit(s.ticks.value());
+        }
+        if (s.g.has_value()) {
+            sim.set_gravity(s.g.value());
+        }
+        for (auto [cell, value] : s.rho) {
+            sim.set_density(cell, value);
+        }
+        if (s.seed.has_value()) {
+            sim.set_seed(s.seed.value());
+        }
+        sim.set_rng_mode(s.rng_mode);
+        sim.set_flow_solver(s.flow_solver);
+        sim.set_frame_output(s.output);
+        if (s.rest_threshold > 0) {
+            sim.set_rest_threshold(s.rest_threshold);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        sim.run(out);
+        result.time  = std::chrono::steady_clock::now() - start;
+        result.ticks = sim.get_tick() - origin.get_tick();
+
+        out << "Ticks: " << result.ticks << "\nTicks/s: "
+            << result.ticks / std::chrono::duration<double>(result.time).count()
+            << '\n';
+        if (!out.flush()) {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run(std::clamp<size_t>(workers, 1, scenarios.size()), [&](size_t) {
+        for (size_t k; (k = next.fetch_add(1)) < order.size();) {
+            auto&& s     = scenarios[order[k]];
+            auto& result = batch.scenarios[order[k]];
+            result.name  = s.name;
+            try {
+                run_one(s, result);
+            } catch (const std::exception& e) {
+                result.error = e.what();
+            }
+        }
+    });
+    batch.time = std::chrono::steady_clock::now() - start;
+    return batch;
+}
+
+} // namespace Fluid
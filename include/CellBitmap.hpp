@@ -0,0 +1,56 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Fluid {
+
+// One bit per cell, rows padded to whole words, so regions whose columns
+// start at multiples of 64 never share a word.
+class CellBitmap {
+  public:
+    void resize(size_t rows, size_t cols) {
+        words_per_row = (cols + 63) / 64;
+        words.assign(rows * words_per_row, 0);
+    }
+
+    void set(size_t x, size_t y) {
+        words[x * words_per_row + y / 64] |= uint64_t{ 1 } << (y % 64);
+    }
+
+    // Calls func(x, y) for every set cell of [x0, x1) x [y0, y1) in row-major
+    // order and clears it.
+    template <typename F>
+    void drain(size_t x0, size_t x1, size_t y0, size_t y1, F&& func) {
+        for (size_t x = x0; x < x1; ++x) {
+            uint64_t* row = words.data() + x * words_per_row;
+            for (size_t w = y0 / 64; w * 64 < y1; ++w) {
+                uint64_t bits = row[w] & range_mask(w, y0, y1);
+                row[w] &= ~bits;
+                while (bits != 0) {
+                    func(x, w * 64 + std::countr_zero(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+
+  private:
+    static uint64_t range_mask(size_t w, size_t y0, size_t y1) {
+        uint64_t mask = ~uint64_t{ 0 };
+        if (y0 > w * 64) {
+            mask &= ~uint64_t{ 0 } << (y0 - w * 64);
+        }
+        if (y1 < (w + 1) * 64) {
+            mask &= ~(~uint64_t{ 0 } << (y1 - w * 64));
+        }
+        return mask;
+    }
+
+    size_t words_per_row = 0;
+    std::vector<uint64_t> words;
+};
+
+} // namespace Fluid
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace Fluid {
+
+enum class SectionId : uint32_t {
+    P,
+    OLD_P,
+    FIELD,
+    VELOCITY,
+    VELOCITY_FLOW,
+    LAST_USE,
+    DIRS,
+    RHO,
+    G,
+    CELLS,
+    PARENT
+};
+
+enum class CheckpointKind : uint32_t {
+    FULL,
+    DELTA
+};
+
+// Cell storage the array sections were written with; sections are raw
+// copies, so they only load into a build with the same layout.
+enum class CellLayout : uint32_t {
+    AOS,
+    SOA
+};
+
+inline std::string layout_name(CellLayout layout, uint32_t row_alignment) {
+    if (layout == CellLayout::AOS) {
+        return "AoS";
+    }
+    return "SoA(" + std::to_string(row_alignment) + ")";
+}
+
+struct CheckpointSection {
+    SectionId id;
+    uint32_t elem_size;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// Fixed-size header of the binary checkpoint. Array sections follow the
+// section table, each starting at a multiple of ALIGNMENT.
+struct CheckpointHeader {
+    static constexpr std::array<char, 8> MAGIC{ 'F', 'L', 'U', 'I',
+                                                'D', 'C', 'P', '\0' };
+    static constexpr uint32_t VERSION    = 4;
+    static constexpr size_t ALIGNMENT    = 64;
+    static constexpr size_t NAME_SIZE    = 32;
+    static constexpr size_t RNG_WORDS    = 625;
+    static constexpr size_t MAX_SECTIONS = 16;
+
+    std::array<char, 8> magic = MAGIC;
+    uint32_t version          = VERSION;
+    uint32_t section_count    = 0;
+    CheckpointKind kind       = CheckpointKind::FULL;
+    CellLayout layout         = CellLayout::AOS;
+    uint32_t row_alignment    = 0;
+    std::array<char, NAME_SIZE> p_type{};
+    std::array<char, NAME_SIZE> v_type{};
+    std::array<char, NAME_SIZE> v_flow_type{};
+    uint64_t rows      = 0;
+    uint64_t cols      = 0;
+    uint64_t tick      = 0;
+    int64_t ut         = 0;
+    uint64_t seed      = 0;
+    uint32_t rng_words = 0;
+    std::array<uint32_t, RNG_WORDS> rng{};
+    std::array<CheckpointSection, MAX_SECTIONS> sections{};
+
+    void set_types(std::string_view p, std::string_view v, std::string_view v_flow) {
+        copy_name(p_type, p);
+        copy_name(v_type, v);
+        copy_name(v_flow_type, v_flow);
+    }
+
+    template <typename Rng>
+    void save_rng(const Rng& rnd) {
+        std::stringstream ss;
+        ss << rnd;
+        rng_words = 0;
+        uint64_t word;
+        while (rng_words < RNG_WORDS && ss >> word) {
+            rng[rng_words++] = static_cast<uint32_t>(word);
+        }
+    }
+
+    template <typename Rng>
+    void load_rng(Rng& rnd) const {
+        std::stringstream ss;
+        for (size_t i = 0; i < rng_words; ++i) {
+            ss << rng[i] << ' ';
+        }
+        ss >> rnd;
+    }
+
+  private:
+    static void copy_name(std::array<char, NAME_SIZE>& dst, std::string_view src) {
+        if (src.size() >= NAME_SIZE) {
+            throw std::runtime_error("Type name is too long for checkpoint: " +
+                                     std::string(src));
+        }
+        dst.fill('\0');
+        std::memcpy(dst.data(), src.data(), src.size());
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<CheckpointHeader>);
+
+class CheckpointWriter {
+  public:
+    CheckpointWriter(std::ostream& out, CheckpointHeader& header)
+        : out(out),
+          header(header),
+          offset(align(sizeof(CheckpointHeader))) {
+        header.section_count = 0;
+    }
+
+    template <typename Container>
+    void add(SectionId id, const Container& data) {
+        using T = std::remove_cvref_t<decltype(*std::data(data))>;
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        if (header.section_count == CheckpointHeader::MAX_SECTIONS) {
+            throw std::runtime_error("Too many checkpoint sections");
+        }
+        uint64_t bytes = std::size(data) * sizeof(T);
+        header.sections[header.section_count++] = { id, sizeof(T), offset, bytes };
+        payload.emplace_back(reinterpret_cast<const char*>(std::data(data)), bytes);
+        offset = align(offset + bytes);
+    }
+
+    void finish() {
+        write_padded(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (auto [ptr, bytes] : payload) {
+            write_padded(ptr, bytes);
+        }
+        out.flush();
+    }
+
+  private:
+    static uint64_t align(uint64_t value) {
+        return (value + CheckpointHeader::ALIGNMENT - 1) /
+               CheckpointHeader::ALIGNMENT * CheckpointHeader::ALIGNMENT;
+    }
+
+    void write_padded(const char* ptr, uint64_t bytes) {
+        static constexpr std::array<char, CheckpointHeader::ALIGNMENT> zeros{};
+        out.write(ptr, bytes);
+        out.write(zeros.data(), align(bytes) - bytes);
+    }
+
+    std::ostream& out;
+    CheckpointHeader& header;
+    uint64_t offset;
+    std::vector<std::pair<const char*, uint64_t>> payload;
+};
+
+class CheckpointReader {
+  public:
+    explicit CheckpointReader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open checkpoint: " + path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(CheckpointHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Checkpoint is truncated: " + path);
+        }
+        size      = st.st_size;
+        void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Cannot mmap checkpoint: " + path);
+        }
+        data = static_cast<const char*>(ptr);
+        std::memcpy(&hdr, data, sizeof(hdr));
+
+        if (hdr.magic != CheckpointHeader::MAGIC ||
+            hdr.version != CheckpointHeader::VERSION ||
+            hdr.section_count > CheckpointHeader::MAX_SECTIONS) {
+            unmap();
+            throw std::runtime_error("Not a supported checkpoint: " + path);
+        }
+        for (auto* name : { &hdr.p_type, &hdr.v_type, &hdr.v_flow_type }) {
+            if (std::ranges::find(*name, '\0') == name->end()) {
+                unmap();
+                throw std::runtime_error("Corrupted type name in checkpoint: " +
+                                         path);
+            }
+        }
+        for (size_t i = 0; i < hdr.section_count; ++i) {
+            auto& s = hdr.sections[i];
+            if (s.offset + s.bytes > size) {
+                unmap();
+                throw std::runtime_error("Checkpoint section out of bounds: " +
+                                         path);
+            }
+        }
+    }
+
+    CheckpointReader(const CheckpointReader&)            = delete;
+    CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+    ~CheckpointReader() {
+        unmap();
+    }
+
+    static bool is_checkpoint(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::array<char, 8> magic{};
+        file.read(magic.data(), magic.size());
+        return file && magic == CheckpointHeader::MAGIC;
+    }
+
+    const CheckpointHeader& header() const {
+        return hdr;
+    }
+
+    template <typename T>
+    std::span<const T> section(SectionId id) const {
+        for (size_t i = 0; i < hdr.section_count; ++i) {
+            auto& s = hdr.sections[i];
+            if (s.id == id) {
+                if (s.elem_size != sizeof(T)) {
+                    throw std::runtime_error("Checkpoint element size mismatch");
+                }
+                return { reinterpret_cast<const T*>(data + s.offset),
+                         s.bytes / sizeof(T) };
+            }
+        }
+        throw std::runtime_error("Checkpoint section is missing");
+    }
+
+    template <typename Container>
+    void copy_to(SectionId id, Container&& dst) const {
+        using T  = std::remove_cvref_t<decltype(*std::data(dst))>;
+        auto src = section<T>(id);
+        if (src.size() != std::size(dst)) {
+            throw std::runtime_error("Checkpoint section size mismatch");
+        }
+        std::memcpy(std::data(dst), src.data(), src.size_bytes());
+    }
+
+    bool has_section(SectionId id) const {
+        for (size_t i = 0; i < hdr.section_count; ++i) {
+            if (hdr.sections[i].id == id) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    void unmap() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+            data = nullptr;
+        }
+    }
+
+    CheckpointHeader hdr{};
+    const char* data = nullptr;
+    size_t size      = 0;
+};
+
+// Returns the files to replay for a checkpoint: the full base first, then
+// every delta up to and including `path`.
+inline std::vector<std::string> checkpoint_chain(const std::string& path) {
+    std::vector<std::string> chain{ path };
+    while (true) {
+        CheckpointReader reader{ chain.back() };
+        if (reader.header().kind == CheckpointKind::FULL) {
+            break;
+        }
+        auto parent = reader.section<char>(SectionId::PARENT);
+        auto dir    = std::filesystem::path(chain.back()).parent_path();
+        chain.push_back(dir / std::string(parent.begin(), parent.end()));
+    }
+    std::ranges::reverse(chain);
+    return chain;
+}
+
+// Writes periodic checkpoints: a full base the first time, then sparse
+// deltas against the previously written snapshot. The chain only advances
+// once a file is completely written, so after a failed write the next
+// delta still refers to a parent that exists on disk.
+template <typename Snapshot>
+class DeltaCheckpointer {
+  public:
+    std::string write(const Snapshot& snapshot, CheckpointHeader header) {
+        std::string path = "checkpoint_" + std::to_string(snapshot.tick);
+        if (prev) {
+            path += ".delta";
+        }
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open checkpoint for writing: " + path);
+        }
+
+        try {
+            if (prev) {
+                auto parent = std::filesystem::path(prev_path).filename().string();
+                snapshot.serialize_delta(file, header, *prev, parent);
+            } else {
+                snapshot.serialize_binary(file, header);
+            }
+            if (!file.flush()) {
+                throw std::runtime_error("Failed to write checkpoint: " + path);
+            }
+        } catch (...) {
+            file.close();
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            throw;
+        }
+
+        if (prev) {
+            *prev = snapshot;
+        } else {
+            prev = std::make_unique<Snapshot>(snapshot);
+        }
+        prev_path = path;
+        return path;
+    }
+
+  private:
+    std::unique_ptr<Snapshot> prev;
+    std::string prev_path;
+};
+
+} // namespace Fluid
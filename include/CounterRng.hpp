@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace Fluid {
+
+// Counter-based generator: the n-th draw of a stream is a pure function of
+// its key and n (SplitMix64), so a stream can be replayed from the start and
+// streams of different cells never depend on the order they are used in.
+class CounterRng {
+  public:
+    using result_type = uint32_t;
+
+    CounterRng() = default;
+
+    CounterRng(uint64_t seed, uint64_t tick, uint64_t cell)
+        : key{ mix(mix(seed ^ mix(tick)) ^ cell) } {
+    }
+
+    result_type operator()() {
+        return static_cast<result_type>(mix(key + ++counter * GAMMA) >> 32);
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+
+  private:
+    static constexpr uint64_t GAMMA = 0x9e3779b97f4a7c15;
+
+    static constexpr uint64_t mix(uint64_t z) {
+        z += GAMMA;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key{};
+    uint64_t counter{};
+};
+
+} // namespace Fluid
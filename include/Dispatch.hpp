@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Fluid {
+
+// FNV-1a of the names of a FluidSim specialization: the p, v and v_flow
+// types and the static size, "" for the dynamic one. Spaces are skipped, so
+// "FIXED(32, 16)" and "FIXED(32,16)" name the same type.
+constexpr uint64_t instance_key(std::string_view p_type, std::string_view v_type,
+                                std::string_view v_flow_type,
+                                std::string_view size) {
+    uint64_t hash = 14695981039346656037ull;
+    auto add      = [&](char c) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    };
+    for (auto name : { p_type, v_type, v_flow_type, size }) {
+        for (char c : name) {
+            if (c != ' ') {
+                add(c);
+            }
+        }
+        add('/');
+    }
+    return hash;
+}
+
+template <typename Run>
+struct InstanceEntry {
+    uint64_t key;
+    std::string_view p_type;
+    std::string_view v_type;
+    std::string_view v_flow_type;
+    std::string_view size;
+    Run run;
+};
+
+template <typename Run, size_t N>
+constexpr bool unique_keys(const std::array<InstanceEntry<Run>, N>& table) {
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i + 1; j < N; ++j) {
+            if (table[i].key == table[j].key) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Run, size_t N>
+constexpr const InstanceEntry<Run>*
+find_instance(const std::array<InstanceEntry<Run>, N>& table, uint64_t key) {
+    for (auto&& entry : table) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace Fluid
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "Simd.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Fluid {
+
+// A field file read once: the file is mapped, and a single pass checks that
+// it is a rectangle of printable characters enclosed by walls and builds
+// the open mask of every cell. Lines end in "\n" or "\r\n", the last one
+// optionally. Cells are read from the mapping; the simulation copies them
+// and the wall geometry without reading the file again.
+class FieldFile {
+  public:
+    explicit FieldFile(const std::string& path)
+        : path(path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Error: Cannot open field " + path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Error: Field " + path + " is empty");
+        }
+        size      = st.st_size;
+        void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Error: Cannot mmap field " + path);
+        }
+        data = static_cast<const char*>(ptr);
+        ::madvise(ptr, size, MADV_SEQUENTIAL);
+
+        try {
+            scan();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    FieldFile(const FieldFile&)            = delete;
+    FieldFile& operator=(const FieldFile&) = delete;
+
+    ~FieldFile() {
+        unmap();
+    }
+
+    size_t rows() const {
+        return n_rows;
+    }
+
+    size_t cols() const {
+        return n_cols;
+    }
+
+    char cell(size_t x, size_t y) const {
+        return data[x * stride + y];
+    }
+
+    // OPEN_SELF and open_bit(d) for the open neighbours of an inner cell
+    // that is not a wall, 0 otherwise.
+    uint8_t open(size_t x, size_t y) const {
+        return open_mask[x * n_cols + y];
+    }
+
+    // Number of open neighbours, as FluidSim keeps it in dirs.
+    int dirs(size_t x, size_t y) const {
+        return std::popcount(static_cast<unsigned>(open(x, y) & ~simd::OPEN_SELF));
+    }
+
+  private:
+    void scan() {
+        auto* newline = static_cast<const char*>(std::memchr(data, '\n', size));
+        n_cols        = newline == nullptr ? size : newline - data;
+        size_t eol    = 1;
+        if (n_cols > 0 && data[n_cols - 1] == '\r') {
+            --n_cols;
+            eol = 2;
+        }
+        stride = n_cols + eol;
+        if (n_cols < 3) {
+            fail(0, "a field is at least 3 cells wide");
+        }
+
+        // A missing end of line is only allowed after the last row.
+        n_rows = (size + eol) / stride;
+        if (n_rows * stride != size && n_rows * stride != size + eol) {
+            fail(n_rows, "expected " + std::to_string(n_cols) + " cells");
+        }
+        if (n_rows < 3) {
+            fail(n_rows, "a field is at least 3 rows high");
+        }
+
+        open_mask.assign(n_rows * n_cols, 0);
+        for (size_t x = 0; x < n_rows; ++x) {
+            check_row(x);
+            if (x >= 2) {
+                build_row(x - 1);
+            }
+        }
+    }
+
+    void check_row(size_t x) const {
+        const char* row = data + x * stride;
+        bool border     = x == 0 || x + 1 == n_rows;
+        for (size_t y = 0; y < n_cols; ++y) {
+            char c = row[y];
+            if (c < ' ' || c > '~') {
+                fail(x, c == '\n' || c == '\r'
+                            ? "expected " + std::to_string(n_cols) + " cells"
+                            : "unexpected character code " +
+                                  std::to_string(static_cast<unsigned char>(c)));
+            }
+            if ((border || y == 0 || y + 1 == n_cols) && c != '#') {
+                fail(x, "the field must be enclosed by walls ('#')");
+            }
+        }
+        if (x + 1 < n_rows) {
+            bool crlf = stride - n_cols == 2;
+            if ((crlf && row[n_cols] != '\r') || row[stride - 1] != '\n') {
+                fail(x, "expected " + std::to_string(n_cols) + " cells");
+            }
+        }
+    }
+
+    // Needs the rows above and below checked.
+    void build_row(size_t x) {
+        for (size_t y = 1; y + 1 < n_cols; ++y) {
+            if (cell(x, y) == '#') {
+                continue;
+            }
+            uint8_t mask = simd::OPEN_SELF;
+            for (size_t d = 0; d < simd::dir_offsets.size(); ++d) {
+                auto [dx, dy] = simd::dir_offsets[d];
+                if (cell(x + dx, y + dy) != '#') {
+                    mask |= simd::open_bit(d);
+                }
+            }
+            open_mask[x * n_cols + y] = mask;
+        }
+    }
+
+    [[noreturn]] void fail(size_t row, const std::string& what) const {
+        throw std::runtime_error("Error: " + path + ": line " +
+                                 std::to_string(row + 1) + ": " + what);
+    }
+
+    void unmap() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+            data = nullptr;
+        }
+    }
+
+    std::string path;
+    const char* data = nullptr;
+    size_t size      = 0;
+    size_t stride    = 0;
+    size_t n_rows    = 0;
+    size_t n_cols    = 0;
+    std::vector<uint8_t> open_mask;
+};
+
+} // namespace Fluid
@@ -1,26 +1,49 @@
 #pragma once
 
 #include "Array2d.hpp"
-#include "ConcurentVector.h"
+#include "CellBitmap.hpp"
+#include "Checkpoint.hpp"
+#include "CounterRng.hpp"
+#include "FrameWriter.hpp"
+#include "Profiler.hpp"
+#include "SegmentedBuffer.hpp"
+#include "Simd.hpp"
+#include "TileScheduler.hpp"
+#include "Trajectory.hpp"
+#include "Types.hpp"
+#include "WorkerPool.hpp"
 #include <algorithm>
 #include <array>
-#include <barrier>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstddef>
 #include <cstring>
 #include <ctime>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <random>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <type_traits>
 
 namespace Fluid {
 
+// Gives benchmarks access to the single tick phases (bench/Bench.hpp).
+struct PhaseAccess;
+
 template <size_t N, size_t K>
 struct StaticSize {
     static constexpr size_t rows  = N;
@@ -28,15 +51,152 @@ struct StaticSize {
     static constexpr size_t value = N * K;
 };
 
+// Cell storage policies. AoS keeps the four velocity components of a cell
+// together; SoA stores every direction as its own plane and pads all rows
+// to a cache line.
+struct AoS {
+    using Rows                   = RowMajor;
+    static constexpr bool planar = false;
+};
+
+template <size_t Align = 64>
+struct SoA {
+    using Rows                   = PaddedRows<Align>;
+    static constexpr bool planar = true;
+};
+
+// Random numbers of the movement phase. MT19937 is the reference: one
+// generator consumed in scan order, so make_step runs serially. COUNTER
+// gives every chain its own stream and runs tiles in parallel.
+enum class RngMode {
+    MT19937,
+    COUNTER
+};
+
+// Cycle search of make_flow_from_vel. UNIT is the reference: a found cycle
+// carries at most 1 and at most the residual of the path leading to it, and
+// its cells are done for the sweep. SATURATING pushes the bottleneck of the
+// cycle itself, so every augmentation saturates an edge for the rest of the
+// tick (at most one augmentation per edge), and releases the cycle's cells
+// so the same sweep keeps searching through them.
+enum class FlowSolver {
+    UNIT,
+    SATURATING
+};
+
+inline RngMode parse_rng_mode(std::string_view name) {
+    if (name == "mt19937") {
+        return RngMode::MT19937;
+    }
+    if (name == "counter") {
+        return RngMode::COUNTER;
+    }
+    throw std::runtime_error("Error: Unknown rng mode: " + std::string{ name });
+}
+
+inline FlowSolver parse_flow_solver(std::string_view name) {
+    if (name == "unit") {
+        return FlowSolver::UNIT;
+    }
+    if (name == "saturating") {
+        return FlowSolver::SATURATING;
+    }
+    throw std::runtime_error("Error: Unknown flow solver: " + std::string{ name });
+}
+
+#ifdef FLUID_SOA_LAYOUT
+using DefaultLayout = SoA<>;
+#else
+using DefaultLayout = AoS;
+#endif
+
 template <typename P_t, typename V_t, typename V_flow_t,
-          typename Size = StaticSize<0, 0>>
+          typename Size = StaticSize<0, 0>, typename Layout = DefaultLayout>
 class FluidSim {
+    friend struct PhaseAccess;
 
     template <typename T>
-    using Arr_t = Array2d<T, Size>;
+    using Arr_t = Array2d<T, Size, typename Layout::Rows>;
+
+    // The vector kernels need one plane per direction and a single lane
+    // type shared by p, velocity and velocity_flow.
+    using Lane = typename SimdLane<V_t>::type;
+    static constexpr bool simd_forces = Layout::planar && !std::is_void_v<Lane>;
+    static constexpr bool simd_recalc =
+        simd_forces && std::is_same_v<P_t, V_t> && std::is_same_v<V_t, V_flow_t>;
+
+    // State of one movement pass. The reference pass draws from the shared
+    // mt19937 in scan order; a counter pass draws from a stream keyed by the
+    // start cell, stays inside `tile` and logs its writes so that the chain
+    // can be undone.
+    struct MoveContext {
+        // A last_use write when nx < 0, a swap of two cells otherwise.
+        struct Undo {
+            int x, y, nx, ny;
+            int last_use;
+        };
+
+        bool counter = false;
+        simd::Region tile{};
+        CounterRng rng;
+        bool aborted = false;
+        bool moved   = false;
+        std::vector<Undo> log;
+        std::vector<std::pair<size_t, size_t>> deferred;
+        std::vector<std::pair<size_t, size_t>> stops;
+    };
+
+    // Explicit stacks of the searches, one set per worker. The searches of a
+    // single call never leave a tile or seam window, except on the calling
+    // thread (the last seam pass and the serial scan), so only worker 0 needs
+    // room for every cell of the field. Reserved up front, they never grow
+    // mid-search. `edges` collects the cells a bounded search could not
+    // enter; the buffers are merged into the next pass.
+    struct FlowFrame {
+        int x, y;
+        V_flow_t lim, ret;
+        size_t d;
+    };
+
+    struct MoveFrame {
+        int x, y, nx, ny;
+        bool is_first;
+    };
+
+    struct StopFrame {
+        int x, y;
+        size_t d;
+    };
+
+    struct alignas(64) SearchStacks {
+        std::vector<FlowFrame> flow;
+        std::vector<MoveFrame> move;
+        std::vector<StopFrame> stop;
+        SegmentedBuffer<std::pair<size_t, size_t>> edges;
+    };
+
+    // Wall-derived data: the number of open neighbours of every cell and the
+    // mask of open directions. Walls never move, so simulations started from
+    // one field share it (start_from).
+    struct Geometry {
+        Geometry(size_t rows, size_t cols)
+            : dirs{ rows, cols },
+              open{ rows, cols } {
+        }
+
+        Arr_t<int> dirs;
+        Arr_t<uint8_t> open;
+    };
+
+    static constexpr size_t MOVE_TILE      = 32;
+    static constexpr size_t FLOW_TILE      = 16;
+    static constexpr size_t ACTIVE_TILE    = 16;
+    static constexpr size_t SEAM_WINDOW    = 64;
+    static constexpr uint64_t DEFAULT_SEED = 1337;
 
   public:
-    FluidSim(size_t rows, size_t cols, size_t num_workers = 1)
+    FluidSim(size_t rows, size_t cols, size_t num_workers = 1,
+             WorkerPool& pool = WorkerPool::shared())
         : rows{ rows },
           cols{ cols },
           p{ rows, cols },
@@ -45,10 +205,11 @@ class FluidSim {
           velocity{ rows, cols },
           velocity_flow{ rows, cols },
           last_use{ rows, cols },
-          dirs{ rows, cols },
+          geometry{ std::make_shared<Geometry>(rows, cols) },
           num_workers{ num_workers },
-          start_point{ static_cast<ptrdiff_t>(num_workers + 1) },
-          end_point{ static_cast<ptrdiff_t>(num_workers + 1) },
+          pool{ pool },
+          flow_scheduler{ num_workers },
+          profiler{ num_workers },
           g{ 0.01 } {
 
             if constexpr (is_static<Size>) {
@@ -60,40 +221,23 @@ class FluidSim {
 
         rho[' '] = 0.01;
         rho['.'] = 1000;
-        calc_borders();
-
-        for (size_t i = 0; i < num_workers; ++i) {
-            threads.emplace_back([&, i]() {
-                while (true) {
-                    start_point.arrive_and_wait();
-
-                    size_t ly = borders[i].first.first;
-                    size_t ry = borders[i].second.first;
-                    size_t lx = borders[i].first.second;
-                    size_t rx = borders[i].second.second;
-
-                    for (size_t x = lx; x <= rx; ++x) {
-                        for (size_t y = ly; y <= ry; ++y) {
-                            if (field(x, y) != '#' &&
-                                last_use(x, y) != offset<false>(0)) {
-                                auto [ret, l, _] =
-                                    propagate_flow<false>(x, y, 1, lx, rx, ly, ry);
-                                if (ret > 0) {
-                                    prop = 1;
-                                }
-                            }
-                        }
-                    }
-
-                    end_point.arrive_and_wait();
-                }
-            });
+        calc_rho_reciprocals();
+        calc_flow_tiles();
+        reserve_search_stacks();
+        seam_cells.resize(rows, cols);
+        if (num_workers > 1) {
+            pool.reserve(num_workers);
         }
     }
 
     ~FluidSim() {
-        for (auto&& t : threads) {
-            t.detach();
+        if (checkpoint_writer.joinable()) {
+            {
+                std::lock_guard lock{ checkpoint_mutex };
+                checkpoint_stop = true;
+            }
+            checkpoint_cv.notify_all();
+            checkpoint_writer.join();
         }
     }
 
@@ -117,6 +261,7 @@ class FluidSim {
                           }
                       });
 
+        auto& dirs = own_geometry().dirs;
         for_each_cell([&](size_t x, size_t y) {
             if (field(x, y) == '#') {
                 return;
@@ -125,147 +270,899 @@ class FluidSim {
                 dirs(x, y) += (field(x + dx, y + dy) != '#');
             }
         });
+        build_open_mask();
+    }
+
+    // Continues from the current state of `origin`, which must be of the same
+    // size, and shares its geometry. Settings are not copied.
+    void start_from(const FluidSim& origin) {
+        if (origin.rows != rows || origin.cols != cols) {
+            throw std::runtime_error("Cannot start from a field of another size");
+        }
+        tick                 = origin.tick;
+        UT                   = origin.UT;
+        seed                 = origin.seed;
+        rnd                  = origin.rnd;
+        field.data           = origin.field.data;
+        p.data               = origin.p.data;
+        old_p.data           = origin.old_p.data;
+        velocity.v.data      = origin.velocity.v.data;
+        velocity_flow.v.data = origin.velocity_flow.v.data;
+        last_use.data        = origin.last_use.data;
+        rho                  = origin.rho;
+        rho_reciprocals      = origin.rho_reciprocals;
+        g                    = origin.g;
+        geometry             = origin.geometry;
     }
 
-    void run() {
+    // Runs until the tick limit, writing the frames the output mode asks for
+    // to `out`.
+    void run(std::ostream& out = std::cout) {
         auto start = std::chrono::system_clock::now();
-        for (; tick < TICKS; ++tick) {
+        frame_writer.start(out, frame_output, rows, cols);
+        for (; tick < tick_limit; ++tick) {
+            if (checkpoint_every != 0 && tick % checkpoint_every == 0) {
+                periodic_requested = true;
+            }
+            poll_checkpoint();
 
-            apply_external_forces();
-            apply_p_forces();
+            profiler.begin_tick(tick);
+            plan_active_tiles();
+            profiler.time(ProfilePhase::EXTERNAL_FORCES, [&] {
+                apply_external_forces();
+            });
+            profiler.time(ProfilePhase::P_FORCES, [&] {
+                apply_p_forces();
+            });
             make_flow_from_vel();
-            recalc_p();
-            if (make_step()) {
-                std::cout << "Tick " << tick << ":\n";
-                for (size_t x = 0; x < rows; ++x) {
-                    for (size_t y = 0; y < cols; ++y) {
-                        std::cout << field(x, y);
-                    }
-                    std::cout << '\n';
-                }
+            profiler.time(ProfilePhase::RECALC_P, [&] {
+                recalc_p();
+            });
+            bool moved = profiler.time(ProfilePhase::MAKE_STEP, [&] {
+                return make_step();
+            });
+            track_active_tiles();
+            profiler.end_tick();
+            if (trajectory) {
+                record_trajectory();
+            }
+            if (moved && frame_output.wants(tick)) {
+                frame_writer.write(tick, field, rows, cols);
             }
         }
+        frame_writer.finish();
+        if (trajectory) {
+            trajectory->flush();
+        }
         auto end = std::chrono::system_clock::now();
 
-        std::cout << "Time: "
-                  << std::chrono::duration_cast<std::chrono::milliseconds>(end -
-                                                                           start)
-                         .count()
-                  << " ms\n";
+        wait_checkpoint();
+        poll_checkpoint();
+        wait_checkpoint();
+
+        out << "Time: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+                   .count()
+            << " ms\n";
     }
 
     void serialize(std::ofstream& file) const {
-        nlohmann::json json;
-
-        json["tick"]          = tick;
-        json["p"]             = p.data;
-        json["old_p"]         = old_p.data;
-        json["field"]         = field.data;
-        json["velocity"]      = velocity.v.data;
-        json["velocity_flow"] = velocity_flow.v.data;
-        json["last_use"]      = last_use.data;
-        json["dirs"]          = dirs.data;
-        json["rho"]           = rho;
-        json["g"]             = g;
-
-        file << json.dump();
+        write_json(file, *this);
     }
 
     void deserialize(std::ifstream& file) {
         nlohmann::json json;
         file >> json;
 
-        tick            = json["tick"].get<size_t>();
-        p.data          = json["p"].get<decltype(p.data)>();
-        old_p.data      = json["old_p"].get<decltype(old_p.data)>();
-        field.data      = json["field"].get<decltype(field.data)>();
-        velocity.v.data = json["velocity"].get<decltype(velocity.v.data)>();
-        velocity_flow.v.data =
-            json["velocity_flow"].get<decltype(velocity_flow.v.data)>();
-        last_use.data = json["last_use"].get<decltype(last_use.data)>();
-        dirs.data     = json["dirs"].get<decltype(dirs.data)>();
-        rho           = json["rho"].get<decltype(rho)>();
-        g             = json["g"].get<V_t>();
+        tick = json["tick"].get<size_t>();
+        if (json.contains("seed")) {
+            seed = json["seed"].get<uint64_t>();
+        }
+        load_dense(p, json["p"]);
+        load_dense(old_p, json["old_p"]);
+        load_dense(field, json["field"]);
+        load_dense(velocity, json["velocity"]);
+        load_dense(velocity_flow, json["velocity_flow"]);
+        load_dense(last_use, json["last_use"]);
+        load_dense(own_geometry().dirs, json["dirs"]);
+        rho = json["rho"].get<decltype(rho)>();
+        g   = json["g"].get<V_t>();
+        build_open_mask();
+        calc_rho_reciprocals();
+    }
+
+    void serialize_binary(std::ostream& file, CheckpointHeader header) const {
+        write_binary(file, header, *this);
+    }
+
+    void deserialize_binary(const CheckpointReader& reader) {
+        auto& header = reader.header();
+        if (header.rows != rows || header.cols != cols) {
+            throw std::runtime_error("Checkpoint size does not match the field");
+        }
+        if (header.layout != CELL_LAYOUT ||
+            header.row_alignment != Layout::Rows::alignment) {
+            throw std::runtime_error(
+                "Checkpoint was written by a " +
+                layout_name(header.layout, header.row_alignment) +
+                " build, this build stores cells as " +
+                layout_name(CELL_LAYOUT, Layout::Rows::alignment));
+        }
+
+        tick = header.tick;
+        UT   = header.ut;
+        seed = header.seed;
+        header.load_rng(rnd);
+
+        if (header.kind == CheckpointKind::DELTA) {
+            apply_delta(reader);
+            build_open_mask();
+            calc_rho_reciprocals();
+            return;
+        }
+
+        reader.copy_to(SectionId::P, p.data);
+        reader.copy_to(SectionId::OLD_P, old_p.data);
+        reader.copy_to(SectionId::FIELD, field.data);
+        reader.copy_to(SectionId::VELOCITY, velocity.v.data);
+        reader.copy_to(SectionId::VELOCITY_FLOW, velocity_flow.v.data);
+        reader.copy_to(SectionId::LAST_USE, last_use.data);
+        reader.copy_to(SectionId::DIRS, own_geometry().dirs.data);
+        reader.copy_to(SectionId::RHO, rho);
+        reader.copy_to(SectionId::G, std::span{ &g, 1 });
+        build_open_mask();
+        calc_rho_reciprocals();
+    }
+
+    struct Snapshot;
+    using CheckpointHandler = std::function<void(const Snapshot&)>;
+
+    void set_checkpoint_handler(CheckpointHandler handler) {
+        checkpoint_handler = std::move(handler);
+        if (!checkpoint_writer.joinable()) {
+            checkpoint_writer = std::thread([this] {
+                checkpoint_loop();
+            });
+        }
+    }
+
+    // Async-signal-safe: the snapshot is taken at the next tick boundary.
+    void request_checkpoint() {
+        checkpoint_requested.store(true, std::memory_order_relaxed);
+    }
+
+    // For signal handlers, which may only store to a lock-free atomic.
+    std::atomic<bool>& checkpoint_request_flag() {
+        return checkpoint_requested;
+    }
+
+    void set_tick_limit(size_t ticks) {
+        tick_limit = ticks;
+    }
+
+    void set_frame_output(FrameOutput output) {
+        frame_output = output;
+    }
+
+    // Records the state after every following tick to `path`. The header
+    // supplies the type names, streams and keyframe interval.
+    void set_trajectory(const std::string& path, TrajectoryHeader header) {
+        header.rows          = rows;
+        header.cols          = cols;
+        header.p_size        = sizeof(P_t);
+        header.velocity_size = sizeof(VelocityCell);
+        trajectory           = std::make_unique<TrajectoryWriter>(path, header);
+        trajectory_field.resize(rows * cols);
+        trajectory_p.resize(header.streams & TRAJECTORY_P ? rows * cols : 0);
+        trajectory_velocity.resize(
+            header.streams & TRAJECTORY_VELOCITY ? rows * cols : 0);
+    }
+
+    // Frames the last run() dropped because the frame ring was full.
+    size_t dropped_frames() const {
+        return frame_writer.dropped_frames();
+    }
+
+    void set_checkpoint_every(size_t ticks) {
+        checkpoint_every = ticks;
+    }
+
+    void set_rng_mode(RngMode mode) {
+        rng_mode = mode;
+        calc_flow_tiles();
+    }
+
+    // Skips tiles that stayed below `threshold` (0 turns tracking off).
+    void set_rest_threshold(double threshold) {
+        rest_threshold = threshold;
+        active_rows    = (rows + ACTIVE_TILE - 1) / ACTIVE_TILE;
+        active_cols    = (cols + ACTIVE_TILE - 1) / ACTIVE_TILE;
+        tile_quiet.assign(active_rows * active_cols, 0);
+        tile_skip.assign(active_rows * active_cols, 0);
+        tile_moved.assign(active_rows * active_cols, 0);
+    }
+
+    // Share of tiles skipped in every tick run with rest tracking on.
+    const std::vector<double>& skip_history() const {
+        return skip_ratios;
+    }
+
+    void set_gravity(double value) {
+        g = V_t(value);
+    }
+
+    void set_density(char cell, double value) {
+        auto c             = static_cast<unsigned char>(cell);
+        rho[c]             = P_t(value);
+        rho_reciprocals[c] = Reciprocal<P_t>{ rho[c] };
+    }
+
+    void set_flow_solver(FlowSolver solver) {
+        flow_solver = solver;
+    }
+
+    // Sweeps of make_flow_from_vel over the whole run.
+    size_t flow_sweeps() const {
+        return flow_sweep_count;
+    }
+
+    // Seam cells handed to the parallel window passes and, of what those
+    // could not reach, to the serial pass, duplicates included.
+    std::pair<size_t, size_t> seam_counts() const {
+        return { window_seam_count, serial_seam_count };
+    }
+
+    // Seeds both movement modes. A loaded checkpoint brings its own seed.
+    void set_seed(uint64_t value) {
+        seed = value;
+        rnd.seed(static_cast<std::mt19937::result_type>(value));
+    }
+
+    const std::vector<TileScheduler::WorkerStats>& flow_stats() const {
+        return flow_scheduler.worker_stats();
+    }
+
+    const Profiler<>& profile() const {
+        return profiler;
     }
 
   private:
-    void calc_borders() {
-        size_t backet_size = cols / num_workers;
+    static constexpr CellLayout CELL_LAYOUT =
+        Layout::planar ? CellLayout::SOA : CellLayout::AOS;
 
-        for (size_t i = 0; i < num_workers; ++i) {
-            if (i == num_workers - 1) {
-                borders.emplace_back(std::make_pair(i * backet_size, 0),
-                                     std::make_pair(cols - 1, rows - 1));
-            } else {
-                borders.emplace_back(
-                    std::make_pair(i * backet_size, 0),
-                    std::make_pair((i + 1) * backet_size - 2, rows - 1));
+    // The writers take a simulation or a snapshot; only the former keeps
+    // dirs in its shared geometry.
+    static const Arr_t<int>& dirs_of(const FluidSim& s) {
+        return s.geometry->dirs;
+    }
+
+    static const Arr_t<int>& dirs_of(const auto& s) {
+        return s.dirs;
+    }
+
+    // JSON is an export format: arrays are written row by row without the
+    // row padding, and velocities cell by cell, whatever the layout.
+    static void write_json(std::ostream& file, const auto& s) {
+        nlohmann::json json;
+
+        json["tick"]          = s.tick;
+        json["seed"]          = s.seed;
+        json["p"]             = dense(s.p, s.rows, s.cols);
+        json["old_p"]         = dense(s.old_p, s.rows, s.cols);
+        json["field"]         = dense(s.field, s.rows, s.cols);
+        json["velocity"]      = dense(s.velocity, s.rows, s.cols);
+        json["velocity_flow"] = dense(s.velocity_flow, s.rows, s.cols);
+        json["last_use"]      = dense(s.last_use, s.rows, s.cols);
+        json["dirs"]          = dense(dirs_of(s), s.rows, s.cols);
+        json["rho"]           = s.rho;
+        json["g"]             = s.g;
+
+        file << json.dump();
+    }
+
+    static auto dense(const auto& a, size_t rows, size_t cols) {
+        if constexpr (requires { a.cell(0, 0); }) {
+            std::vector<decltype(a.cell(0, 0))> ret;
+            ret.reserve(rows * cols);
+            for (size_t x = 0; x < rows; ++x) {
+                for (size_t y = 0; y < cols; ++y) {
+                    ret.push_back(a.cell(x, y));
+                }
             }
+            return ret;
+        } else {
+            std::vector<std::remove_cvref_t<decltype(a(0, 0))>> ret;
+            ret.reserve(rows * cols);
+            for (size_t x = 0; x < rows; ++x) {
+                for (size_t y = 0; y < cols; ++y) {
+                    ret.push_back(a(x, y));
+                }
+            }
+            return ret;
         }
     }
 
-    void apply_external_forces() {
-        for_each_cell([&](size_t x, size_t y) {
-            if (field(x, y) == '#') {
+    void load_dense(auto& a, const nlohmann::json& json) {
+        auto values = json.get<decltype(dense(a, 0, 0))>();
+        if (values.size() != rows * cols) {
+            throw std::runtime_error(
+                "JSON checkpoint size does not match the field");
+        }
+        for (size_t x = 0; x < rows; ++x) {
+            for (size_t y = 0; y < cols; ++y) {
+                if constexpr (requires { a.set_cell(x, y, values[0]); }) {
+                    a.set_cell(x, y, values[x * cols + y]);
+                } else {
+                    a(x, y) = values[x * cols + y];
+                }
+            }
+        }
+    }
+
+    static void fill_header(CheckpointHeader& header, const auto& s) {
+        header.rows          = s.rows;
+        header.cols          = s.cols;
+        header.tick          = s.tick;
+        header.ut            = s.UT;
+        header.seed          = s.seed;
+        header.layout        = CELL_LAYOUT;
+        header.row_alignment = Layout::Rows::alignment;
+        header.save_rng(s.rnd);
+    }
+
+    static void write_binary(std::ostream& file, CheckpointHeader header,
+                             const auto& s) {
+        fill_header(header, s);
+        header.kind = CheckpointKind::FULL;
+
+        CheckpointWriter writer{ file, header };
+        writer.add(SectionId::P, s.p.data);
+        writer.add(SectionId::OLD_P, s.old_p.data);
+        writer.add(SectionId::FIELD, s.field.data);
+        writer.add(SectionId::VELOCITY, s.velocity.v.data);
+        writer.add(SectionId::VELOCITY_FLOW, s.velocity_flow.v.data);
+        writer.add(SectionId::LAST_USE, s.last_use.data);
+        writer.add(SectionId::DIRS, dirs_of(s).data);
+        writer.add(SectionId::RHO, s.rho);
+        writer.add(SectionId::G, std::span{ &s.g, 1 });
+        writer.finish();
+    }
+
+    void apply_delta(const CheckpointReader& reader) {
+        auto cells         = reader.section<uint32_t>(SectionId::CELLS);
+        auto cell_field    = reader.section<char>(SectionId::FIELD);
+        auto cell_p        = reader.section<P_t>(SectionId::P);
+        auto cell_velocity = reader.section<VelocityCell>(SectionId::VELOCITY);
+        if (cell_field.size() != cells.size() || cell_p.size() != cells.size() ||
+            cell_velocity.size() != cells.size()) {
+            throw std::runtime_error("Corrupted delta checkpoint");
+        }
+
+        for (size_t i = 0; i < cells.size(); ++i) {
+            size_t x = cells[i] / cols;
+            size_t y = cells[i] % cols;
+            if (x >= rows) {
+                throw std::runtime_error("Corrupted delta checkpoint");
+            }
+            field(x, y)      = cell_field[i];
+            p(x, y)          = cell_p[i];
+            velocity.set_cell(x, y, cell_velocity[i]);
+        }
+    }
+
+    void poll_checkpoint() {
+        bool manual = checkpoint_requested.load(std::memory_order_relaxed);
+        if (!(manual || periodic_requested) || !checkpoint_handler) {
+            return;
+        }
+        {
+            std::lock_guard lock{ checkpoint_mutex };
+            if (checkpoint_ready) {
+                return;
+            }
+        }
+        if (manual) {
+            checkpoint_requested.store(false, std::memory_order_relaxed);
+        } else {
+            periodic_requested = false;
+        }
+        if (!snapshot) {
+            snapshot = std::make_unique<Snapshot>(rows, cols);
+        }
+        snapshot->capture(*this);
+        snapshot->periodic = !manual;
+        {
+            std::lock_guard lock{ checkpoint_mutex };
+            checkpoint_ready = true;
+        }
+        checkpoint_cv.notify_all();
+    }
+
+    void wait_checkpoint() {
+        std::unique_lock lock{ checkpoint_mutex };
+        checkpoint_cv.wait(lock, [&] {
+            return !checkpoint_ready;
+        });
+    }
+
+    void checkpoint_loop() {
+        std::unique_lock lock{ checkpoint_mutex };
+        while (true) {
+            checkpoint_cv.wait(lock, [&] {
+                return checkpoint_ready || checkpoint_stop;
+            });
+            if (!checkpoint_ready) {
                 return;
             }
-            if (field(x + 1, y) != '#') {
-                velocity.add(x, y, 1, 0, g);
+            lock.unlock();
+            // A failed write costs this checkpoint, not the simulation.
+            try {
+                checkpoint_handler(*snapshot);
+            } catch (const std::exception& e) {
+                std::cerr << "Checkpoint failed: " << e.what() << std::endl;
             }
+            lock.lock();
+            checkpoint_ready = false;
+            checkpoint_cv.notify_all();
+        }
+    }
+
+    // Flow tiles leave out their last row and column. Those cells separate
+    // the tiles, so tiles running at the same time never touch neighbouring
+    // cells; the flow reaches them in the seam pass. A single worker gets
+    // one tile without separators, except in counter mode, whose result must
+    // not depend on the number of workers.
+    void calc_flow_tiles() {
+        flow_tiles.clear();
+        if (num_workers == 1 && rng_mode == RngMode::MT19937) {
+            flow_tiles.push_back({ 0, field_rows(), 0, field_cols() });
+        } else if constexpr (is_static<Size>) {
+            flow_tiles.assign(static_flow_tiles.begin(), static_flow_tiles.end());
+        } else {
+            flow_tiles = tile_layout(rows, cols);
+        }
+        flow_cost.assign(flow_tiles.size(), FLOW_TILE * FLOW_TILE);
+        flow_visits.assign(flow_tiles.size(), 0);
+    }
+
+    void reserve_search_stacks() {
+        search_stacks.resize(num_workers);
+        for (size_t i = 0; i < num_workers; ++i) {
+            size_t flow  = i == 0 ? rows * cols : SEAM_WINDOW * SEAM_WINDOW;
+            size_t moves = i == 0 ? rows * cols : MOVE_TILE * MOVE_TILE;
+            search_stacks[i].flow.reserve(std::min(flow, rows * cols));
+            search_stacks[i].move.reserve(std::min(moves, rows * cols));
+            search_stacks[i].stop.reserve(std::min(moves, rows * cols));
+        }
+    }
+
+    // Runs job(i) for every worker i on the pool and returns once all of them
+    // are done. Worker 0 is always the calling thread.
+    void run_phase(const std::function<void(size_t)>& job) {
+        if (num_workers == 1) {
+            worker_index = 0;
+            job(0);
+            return;
+        }
+        pool.run(num_workers, [&](size_t i) {
+            worker_index = i;
+            job(i);
+            profiler.job_done(i);
         });
+        profiler.phase_done();
     }
 
-    void apply_p_forces() {
-        std::copy(p.data.begin(), p.data.end(), old_p.data.begin());
+    // Interior cells of worker i in the per-cell phases: an equal share of
+    // the columns.
+    simd::Region stripe(size_t i) const {
+        size_t rows  = field_rows();
+        size_t cols  = field_cols();
+        size_t width = cols / num_workers;
+        size_t y0    = std::max<size_t>(i * width, 1);
+        size_t y1    = i + 1 == num_workers ? cols - 1 : (i + 1) * width;
+        return { 1, rows - 1, y0, std::max(y0, std::min(y1, cols - 1)) };
+    }
+
+    // The field size; compile-time constants for a static Size, so the
+    // per-cell loops get constant bounds.
+    size_t field_rows() const {
+        if constexpr (is_static<Size>) {
+            return Size::rows;
+        } else {
+            return rows;
+        }
+    }
+
+    size_t field_cols() const {
+        if constexpr (is_static<Size>) {
+            return Size::cols;
+        } else {
+            return cols;
+        }
+    }
+
+    void for_each_cell(simd::Region r, auto&& func) {
+        for (size_t x = r.x0; x < r.x1; ++x) {
+            for (size_t y = r.y0; y < r.y1; ++y) {
+                func(x, y);
+            }
+        }
+    }
+
+    // The geometry about to be rebuilt; a shared one is copied first.
+    Geometry& own_geometry() {
+        if (geometry.use_count() > 1) {
+            geometry = std::make_shared<Geometry>(*geometry);
+        }
+        return *geometry;
+    }
+
+    // The pressure phases divide by densities and open neighbour counts,
+    // which take a handful of values, through these tables.
+    void calc_rho_reciprocals() {
+        for (size_t c = 0; c < rho.size(); ++c) {
+            rho_reciprocals[c] = Reciprocal<P_t>{ rho[c] };
+        }
+    }
+
+    void build_open_mask() {
+        auto& open = own_geometry().open;
+        open.clear();
         for_each_cell([&](size_t x, size_t y) {
             if (field(x, y) == '#') {
                 return;
             }
+            open(x, y) = simd::OPEN_SELF;
             for (auto [dx, dy] : deltas) {
-                int nx = x + dx, ny = y + dy;
-                auto&& field_cell = field(nx, ny);
-                if (field_cell != '#' && old_p(nx, ny) < old_p(x, y)) {
-                    auto force  = old_p(x, y) - old_p(nx, ny);
-                    auto& contr = velocity.get(nx, ny, -dx, -dy);
-                    if (contr * rho[(int)field_cell] >= force) {
-                        contr -= force / rho[(int)field_cell];
-                        continue;
+                if (field(x + dx, y + dy) != '#') {
+                    open(x, y) |= simd::open_bit(dir_index(dx, dy));
+                }
+            }
+        });
+    }
+
+    template <typename T>
+    static auto* lane_ptr(T* ptr) {
+        return reinterpret_cast<Lane*>(ptr);
+    }
+
+    simd::Cells<Lane> simd_cells() {
+        for (size_t d = 0; d < simd::dir_offsets.size(); ++d) {
+            auto [dx, dy] = simd::dir_offsets[d];
+            assert(dir_index(dx, dy) == d);
+        }
+
+        simd::Cells<Lane> c;
+        for (size_t d = 0; d < deltas.size(); ++d) {
+            c.velocity[d] = lane_ptr(&velocity.get(0, 0, d));
+        }
+        c.velocity_stride = velocity.v.row_stride();
+        c.field           = &field(0, 0);
+        c.field_stride    = field.row_stride();
+        c.open            = &geometry->open(0, 0);
+        c.open_stride     = geometry->open.row_stride();
+        c.g               = std::bit_cast<Lane>(g);
+        c.shift           = SimdLane<V_t>::shift;
+
+        if constexpr (simd_recalc) {
+            for (size_t d = 0; d < deltas.size(); ++d) {
+                c.velocity_flow[d] = lane_ptr(&velocity_flow.get(0, 0, d));
+            }
+            c.flow_stride  = velocity_flow.v.row_stride();
+            c.p            = lane_ptr(&p(0, 0));
+            c.p_stride     = p.row_stride();
+            c.dirs         = &geometry->dirs(0, 0);
+            c.dirs_stride  = geometry->dirs.row_stride();
+            c.rho_air      = std::bit_cast<Lane>(rho[' ']);
+            c.rho_water    = std::bit_cast<Lane>(rho['.']);
+            if constexpr (std::is_floating_point_v<Lane>) {
+                c.water_factor = 0.8;
+            } else {
+                c.water_factor = std::bit_cast<Lane>(V_t(0.8));
+            }
+        }
+        return c;
+    }
+
+    size_t active_tile(size_t x, size_t y) const {
+        return x / ACTIVE_TILE * active_cols + y / ACTIVE_TILE;
+    }
+
+    bool resting(size_t x, size_t y) const {
+        return rest_threshold > 0 && tile_skip[active_tile(x, y)];
+    }
+
+    // Calls func on the parts of r that lie in active tiles; on r itself
+    // when rest tracking is off.
+    void for_each_active(simd::Region r, auto&& func) {
+        if (rest_threshold == 0) {
+            func(r);
+            return;
+        }
+        for (size_t x0 = r.x0; x0 < r.x1;) {
+            size_t x1 = std::min(r.x1, (x0 / ACTIVE_TILE + 1) * ACTIVE_TILE);
+            for (size_t y0 = r.y0; y0 < r.y1;) {
+                size_t y1 = std::min(r.y1, (y0 / ACTIVE_TILE + 1) * ACTIVE_TILE);
+                if (!tile_skip[active_tile(x0, y0)]) {
+                    func(simd::Region{ x0, x1, y0, y1 });
+                }
+                y0 = y1;
+            }
+            x0 = x1;
+        }
+    }
+
+    void for_each_active_cell(simd::Region r, auto&& func) {
+        for_each_active(r, [&](simd::Region part) {
+            for_each_cell(part, func);
+        });
+    }
+
+    // A tile is skipped for a tick when it and its eight neighbours were all
+    // quiet during the previous tick. A skipped tile keeps its state, apart
+    // from what active neighbours write into it, and such writes wake it.
+    void plan_active_tiles() {
+        if (rest_threshold == 0) {
+            return;
+        }
+        size_t skipped = 0;
+        for (size_t tx = 0; tx < active_rows; ++tx) {
+            for (size_t ty = 0; ty < active_cols; ++ty) {
+                bool skip = true;
+                for (size_t nx = tx ? tx - 1 : 0;
+                     skip && nx <= std::min(tx + 1, active_rows - 1); ++nx) {
+                    for (size_t ny = ty ? ty - 1 : 0;
+                         skip && ny <= std::min(ty + 1, active_cols - 1); ++ny) {
+                        skip = tile_quiet[nx * active_cols + ny];
+                    }
+                }
+                tile_skip[tx * active_cols + ty] = skip;
+                skipped += skip;
+            }
+        }
+        skip_ratios.push_back(static_cast<double>(skipped) / tile_skip.size());
+    }
+
+    // A tile is quiet when no cell in it moved, no pressure changed by
+    // rest_threshold or more since apply_p_forces and every velocity
+    // component left by the tick is below rest_threshold.
+    void track_active_tiles() {
+        if (rest_threshold == 0) {
+            return;
+        }
+        auto small = [&](auto value) {
+            return std::abs(static_cast<double>(value)) < rest_threshold;
+        };
+        run_phase([&](size_t i) {
+            for (size_t t = i; t < tile_quiet.size(); t += num_workers) {
+                size_t x0  = t / active_cols * ACTIVE_TILE;
+                size_t y0  = t % active_cols * ACTIVE_TILE;
+                size_t x1  = std::min(rows, x0 + ACTIVE_TILE);
+                size_t y1  = std::min(cols, y0 + ACTIVE_TILE);
+                bool quiet = !tile_moved[t];
+                for (size_t x = x0; quiet && x < x1; ++x) {
+                    for (size_t y = y0; quiet && y < y1; ++y) {
+                        if (!(open_mask(x, y) & simd::OPEN_SELF)) {
+                            continue;
+                        }
+                        quiet = small(p(x, y) - old_p(x, y));
+                        for (size_t d = 0; quiet && d < deltas.size(); ++d) {
+                            quiet = small(velocity.get(x, y, d));
+                        }
                     }
-                    force -= contr * rho[(int)field_cell];
-                    contr = 0;
-                    velocity.add(x, y, dx, dy, force / rho[(int)field(x, y)]);
-                    p(x, y) -= force / dirs(x, y);
                 }
+                tile_quiet[t] = quiet;
+                tile_moved[t] = 0;
             }
         });
     }
 
+    simd::Region interior() const {
+        return { 1, field_rows() - 1, 1, field_cols() - 1 };
+    }
+
+    void apply_external_forces() {
+        run_phase([&](size_t i) {
+            for_each_active(stripe(i), [&](simd::Region r) {
+                if constexpr (simd_forces) {
+                    simd::apply_external_forces(simd_cells(), r);
+                    return;
+                }
+                for_each_cell(r, [&](size_t x, size_t y) {
+                    constexpr uint8_t down = simd::OPEN_SELF | open_bits[1];
+                    if ((open_mask(x, y) & down) == down) {
+                        velocity.add(x, y, 1, 0, g);
+                    }
+                });
+            });
+        });
+    }
+
+    // Every velocity component is written by at most one cell: the one with
+    // the higher old pressure. Stripes therefore never race, and the result
+    // does not depend on the number of workers.
+    void apply_p_forces() {
+        std::copy(p.data.begin(), p.data.end(), old_p.data.begin());
+        auto& dirs = geometry->dirs;
+        auto& open = geometry->open;
+        run_phase([&](size_t i) {
+            for_each_active_cell(stripe(i), [&](size_t x, size_t y) {
+                uint8_t mask = open(x, y);
+                if (!(mask & simd::OPEN_SELF)) {
+                    return;
+                }
+                for_each_delta([&]<int dx, int dy>() {
+                    int nx = x + dx, ny = y + dy;
+                    if ((mask & simd::open_bit(dir_index(dx, dy))) &&
+                        old_p(nx, ny) < old_p(x, y)) {
+                        auto&& field_cell = field(nx, ny);
+                        auto force        = old_p(x, y) - old_p(nx, ny);
+                        auto& contr = velocity.get(nx, ny, -dx, -dy);
+                        if (contr * rho[(int)field_cell] >= force) {
+                            contr -= force / rho_reciprocals[(int)field_cell];
+                            return;
+                        }
+                        force -= contr * rho[(int)field_cell];
+                        contr = 0;
+                        velocity.add(x, y, dx, dy,
+                                     force / rho_reciprocals[(int)field(x, y)]);
+                        p(x, y) -= force / dirs_reciprocals<P_t>[dirs(x, y)];
+                    }
+                });
+            });
+        });
+    }
+
+    V_flow_t flow_limit() const {
+        if (flow_solver == FlowSolver::UNIT) {
+            return 1;
+        }
+        if constexpr (std::is_floating_point_v<V_flow_t>) {
+            return std::numeric_limits<V_flow_t>::max();
+        } else {
+            return V_flow_t::from_raw(
+                std::numeric_limits<typename V_flow_t::type>::max());
+        }
+    }
+
+    void flow_tile(size_t i) {
+        size_t lx = flow_tiles[i].x0;
+        size_t rx = flow_tiles[i].x1 - 1;
+        size_t ly = flow_tiles[i].y0;
+        size_t ry = flow_tiles[i].y1 - 1;
+
+        size_t visits = flow_visit_count;
+        for (size_t x = lx; x <= rx; ++x) {
+            for (size_t y = ly; y <= ry; ++y) {
+                if ((open_mask(x, y) & simd::OPEN_SELF) &&
+                    last_use(x, y) != offset<TILE_PASS>(0) && !resting(x, y)) {
+                    auto [ret, l, _] = propagate_flow<TILE_PASS>(
+                        x, y, flow_limit(), lx, rx, ly, ry);
+                    if (ret > 0) {
+                        prop.store(true, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+        flow_visits[i] += flow_visit_count - visits;
+    }
+
+    // Tiles are balanced by the number of cells their search visited during
+    // the previous tick.
     void make_flow_from_vel() {
-        velocity_flow.v.clear();
+        velocity_flow.clear();
+        flow_scheduler.plan(flow_cost);
         do {
-            UT += 4;
-            prop = 0;
+            UT += 2 * FLOW_PASSES;
+            prop.store(false, std::memory_order_relaxed);
+
+            ++flow_sweep_count;
+            profiler.count(ProfileCounter::FLOW_SWEEPS, 0);
+            profiler.time(ProfilePhase::FLOW_SWEEP, [&] {
+                flow_scheduler.refill();
+                auto start = TileScheduler::Clock::now();
+                run_phase([&](size_t i) {
+                    flow_scheduler.run(i, [&](size_t tile) {
+                        flow_tile(tile);
+                    });
+                });
+                flow_scheduler.finish_phase(TileScheduler::Clock::now() - start);
+            });
+
+            if (size_t count = collect_seam_cells()) {
+                window_seam_count += count;
+                profiler.count(ProfileCounter::EDGE_POINTS, 0, count);
+                profiler.time(ProfilePhase::FLOW_SEAMS, [&] {
+                    seam_pass();
+                });
+            }
+        } while (prop.load(std::memory_order_relaxed));
 
-            start_point.arrive_and_wait();
-            end_point.arrive_and_wait();
+        for (size_t i = 0; i < flow_tiles.size(); ++i) {
+            flow_cost[i]   = flow_visits[i] + 1;
+            flow_visits[i] = 0;
+        }
+    }
 
-            for (auto&& [x, y] : edges_points) {
-                auto [t, local_prop, _] = propagate_flow<true>(x, y, 1);
+    // Moves the cells the workers could not enter into the bitmap, which
+    // drops duplicates and hands them out in row-major order whatever order
+    // the workers reached them in. Returns how many were collected.
+    size_t collect_seam_cells() {
+        size_t count = 0;
+        for (auto&& s : search_stacks) {
+            count += s.edges.size();
+            s.edges.for_each([&](auto cell) {
+                seam_cells.set(cell.first, cell.second);
+            });
+            s.edges.clear();
+        }
+        return count;
+    }
+
+    // Seam cells are first searched from in SEAM_WINDOW squares, in four
+    // passes of windows coloured by (row, column) parity, so windows running
+    // at the same time are a window apart and share no cells or neighbours.
+    // Searches stay inside their window; what they cannot enter is searched
+    // from serially at the end. Windows do not depend on the number of
+    // workers, so neither does the result.
+    void seam_pass() {
+        size_t window_rows = (rows + SEAM_WINDOW - 1) / SEAM_WINDOW;
+        size_t window_cols = (cols + SEAM_WINDOW - 1) / SEAM_WINDOW;
+        for (size_t colour = 0; colour < 4; ++colour) {
+            size_t wx0 = colour / 2, wy0 = colour % 2;
+            size_t per_row = (window_cols - wy0 + 1) / 2;
+            size_t count   = (window_rows - wx0 + 1) / 2 * per_row;
+            run_phase([&](size_t i) {
+                for (size_t w = i; w < count; w += num_workers) {
+                    size_t x0 = (wx0 + w / per_row * 2) * SEAM_WINDOW;
+                    size_t y0 = (wy0 + w % per_row * 2) * SEAM_WINDOW;
+                    seam_window({ x0, std::min(rows, x0 + SEAM_WINDOW), y0,
+                                  std::min(cols, y0 + SEAM_WINDOW) });
+                }
+            });
+        }
+
+        if (size_t count = collect_seam_cells()) {
+            serial_seam_count += count;
+            seam_cells.drain(0, rows, 0, cols, [&](size_t x, size_t y) {
+                auto [t, local_prop, _] =
+                    propagate_flow<SEAM_PASS>(x, y, flow_limit());
                 if (t > 0) {
-                    prop = 1;
+                    prop.store(true, std::memory_order_relaxed);
                 }
+            });
+        }
+    }
+
+    void seam_window(simd::Region w) {
+        seam_cells.drain(w.x0, w.x1, w.y0, w.y1, [&](size_t x, size_t y) {
+            auto [t, local_prop, _] = propagate_flow<WINDOW_PASS>(
+                x, y, flow_limit(), w.x0, w.x1 - 1, w.y0, w.y1 - 1);
+            if (t > 0) {
+                prop.store(true, std::memory_order_relaxed);
             }
+        });
+    }
 
-            edges_points.clear();
-        } while (prop);
+    void recalc_p_region(simd::Region region) {
+        for_each_active(region, [&](simd::Region r) {
+            recalc_p_cells(r);
+        });
     }
 
-    void recalc_p() {
-        for_each_cell([&](size_t x, size_t y) {
-            if (field(x, y) == '#') {
+    void recalc_p_cells(simd::Region r) {
+        if constexpr (simd_recalc) {
+            simd::recalc_p(simd_cells(), r);
+            return;
+        }
+        auto& dirs = geometry->dirs;
+        auto& open = geometry->open;
+        for_each_cell(r, [&](size_t x, size_t y) {
+            uint8_t mask = open(x, y);
+            if (!(mask & simd::OPEN_SELF)) {
                 return;
             }
-            for (auto [dx, dy] : deltas) {
+            for_each_delta([&]<int dx, int dy>() {
                 auto old_v = velocity.get(x, y, dx, dy);
                 auto new_v = velocity_flow.get(x, y, dx, dy);
                 if (old_v > 0) {
@@ -275,131 +1172,423 @@ class FluidSim {
                     if (field(x, y) == '.') {
                         force *= 0.8;
                     }
-                    if (field(x + dx, y + dy) == '#') {
-                        p(x, y) += force / dirs(x, y);
+                    using Force  = decltype(force);
+                    auto&& inv = dirs_reciprocals<Force>;
+                    if (!(mask & simd::open_bit(dir_index(dx, dy)))) {
+                        p(x, y) += force / inv[dirs(x, y)];
                     } else {
-                        p(x + dx, y + dy) += force / dirs(x + dx, y + dy);
+                        p(x + dx, y + dy) += force / inv[dirs(x + dx, y + dy)];
                     }
                 }
-            }
+            });
         });
     }
 
+    // A region adds pressure one column past each of its sides. Stripes are
+    // split into halves coloured alternately, so two halves of one colour
+    // are at least two columns apart. Narrow stripes fall back to one pass.
+    void recalc_p() {
+        if (rng_mode == RngMode::COUNTER) {
+            recalc_p_blocks();
+            return;
+        }
+        if (num_workers == 1 || cols / num_workers < 4) {
+            recalc_p_region(interior());
+            return;
+        }
+        for (size_t half = 0; half < 2; ++half) {
+            run_phase([&](size_t i) {
+                auto r     = stripe(i);
+                size_t mid = r.y0 + (r.y1 - r.y0) / 2;
+                (half == 0 ? r.y1 : r.y0) = mid;
+                recalc_p_region(r);
+            });
+        }
+    }
+
+    // Counter mode uses blocks of MOVE_TILE columns instead of stripes, so
+    // the order of the additions, which matters for floating point types,
+    // does not depend on the number of workers. Even and odd blocks take
+    // turns, like the stripe halves.
+    void recalc_p_blocks() {
+        auto all      = interior();
+        size_t blocks = (all.y1 - all.y0 + MOVE_TILE - 1) / MOVE_TILE;
+        for (size_t colour = 0; colour < 2; ++colour) {
+            run_phase([&](size_t i) {
+                for (size_t b = 2 * i + colour; b < blocks; b += 2 * num_workers) {
+                    auto r = all;
+                    r.y0   = all.y0 + b * MOVE_TILE;
+                    r.y1   = std::min(all.y1, r.y0 + MOVE_TILE);
+                    recalc_p_region(r);
+                }
+            });
+        }
+    }
+
     bool make_step() {
         UT += 2;
+        if (rng_mode == RngMode::MT19937) {
+            MoveContext m;
+            bool prop = false;
+            for_each_cell([&](size_t x, size_t y) {
+                prop |= start_move(m, x, y);
+            });
+            return prop;
+        }
+
+        // Tiles do not depend on the number of workers, and chains are
+        // confined to their tile, so the result only depends on the seed.
+        size_t tile_rows = (rows + MOVE_TILE - 1) / MOVE_TILE;
+        size_t tile_cols = (cols + MOVE_TILE - 1) / MOVE_TILE;
+        move_tiles.resize(tile_rows * tile_cols);
+        run_phase([&](size_t i) {
+            for (size_t t = i; t < move_tiles.size(); t += num_workers) {
+                size_t x0 = t / tile_cols * MOVE_TILE;
+                size_t y0 = t % tile_cols * MOVE_TILE;
+
+                auto& m   = move_tiles[t];
+                m.counter = true;
+                m.tile    = { x0, std::min(rows, x0 + MOVE_TILE), y0,
+                              std::min(cols, y0 + MOVE_TILE) };
+                m.moved   = false;
+                m.deferred.clear();
+                m.stops.clear();
+
+                simd::Region cells{ std::max<size_t>(m.tile.x0, 1),
+                                    std::min(m.tile.x1, rows - 1),
+                                    std::max<size_t>(m.tile.y0, 1),
+                                    std::min(m.tile.y1, cols - 1) };
+                for_each_cell(cells, [&](size_t x, size_t y) {
+                    m.moved |= start_move(m, x, y);
+                });
+            }
+        });
+
         bool prop = false;
-        for_each_cell([&](size_t x, size_t y) {
-            if (field(x, y) != '#' && last_use(x, y) != UT) {
-                if (random01() < move_prob(x, y)) {
-                    prop = true;
-                    propagate_move(x, y, true);
+        seam_moves.clear();
+        seam_stops.clear();
+        for (auto&& m : move_tiles) {
+            prop |= m.moved;
+            seam_moves.insert(seam_moves.end(), m.deferred.begin(),
+                              m.deferred.end());
+            seam_stops.insert(seam_stops.end(), m.stops.begin(), m.stops.end());
+        }
+        std::sort(seam_moves.begin(), seam_moves.end());
+        std::sort(seam_stops.begin(), seam_stops.end());
+
+        // Seam pass over the whole field: first the stop floods that reached
+        // a tile edge, then the deferred chains, both in scan order.
+        MoveContext seam;
+        seam.counter = true;
+        seam.tile    = { 0, rows, 0, cols };
+        for (auto [x, y] : seam_stops) {
+            if ((open_mask(x, y) & simd::OPEN_SELF) && last_use(x, y) != UT) {
+                propagate_stop(seam, x, y);
+            }
+        }
+        for (auto [x, y] : seam_moves) {
+            prop |= start_move(seam, x, y);
+        }
+        return prop;
+    }
+
+    // Runs the movement chain starting at (x, y), if the cell is still free.
+    // Returns whether the cell decided to move. A counter chain that left its
+    // tile is undone and queued in `deferred` instead.
+    bool start_move(MoveContext& m, size_t x, size_t y) {
+        if (!(open_mask(x, y) & simd::OPEN_SELF) || last_use(x, y) == UT ||
+            resting(x, y)) {
+            return false;
+        }
+        if (m.counter) {
+            m.rng = CounterRng{ seed, tick, x * cols + y };
+        }
+        size_t stops = m.stops.size();
+
+        bool moved = enter(m, x, y) && random01(m) < move_prob(x, y);
+        if (moved) {
+            propagate_move(m, x, y, true);
+        } else if (!m.aborted) {
+            propagate_stop(m, x, y, true);
+        }
+
+        if (m.aborted) {
+            for (auto it = m.log.rbegin(); it != m.log.rend(); ++it) {
+                if (it->nx < 0) {
+                    last_use(it->x, it->y) = it->last_use;
                 } else {
-                    propagate_stop(x, y, true);
+                    swap_with(it->x, it->y, it->nx, it->ny);
                 }
             }
-        });
-        return prop;
+            m.aborted = false;
+            m.stops.resize(stops);
+            m.deferred.emplace_back(x, y);
+            moved = false;
+        }
+        m.log.clear();
+        return moved;
     }
 
-    template <bool edges>
-    size_t offset(size_t local_offset) const {
-        if constexpr (edges) {
-            return UT - local_offset;
-        } else {
-            return UT - local_offset - 2;
+    // A counter pass may only visit cells whose neighbours all lie in its
+    // tile, since the cells around the tile belong to other workers.
+    static bool inside(const MoveContext& m, int x, int y) {
+        return !m.counter || (x > static_cast<int>(m.tile.x0) &&
+                              x + 1 < static_cast<int>(m.tile.x1) &&
+                              y > static_cast<int>(m.tile.y0) &&
+                              y + 1 < static_cast<int>(m.tile.y1));
+    }
+
+    bool enter(MoveContext& m, int x, int y) {
+        if (!inside(m, x, y)) {
+            m.aborted = true;
+        }
+        return !m.aborted;
+    }
+
+    void set_last_use(MoveContext& m, int x, int y, int value) {
+        if (m.counter) {
+            m.log.push_back({ x, y, -1, -1, last_use(x, y) });
         }
+        last_use(x, y) = value;
     }
 
-    template <bool edges>
+    void move_cell(MoveContext& m, int x, int y, int nx, int ny) {
+        if (m.counter) {
+            m.log.push_back({ x, y, nx, ny, 0 });
+        }
+        profiler.count(ProfileCounter::MOVED_CELLS, worker_index);
+        swap_with(x, y, nx, ny);
+    }
+
+    // A sweep searches in three passes, each with its own pair of last_use
+    // marks (on the stack, done); a later pass sees the marks of the earlier
+    // ones as unvisited. UT advances by 2 * FLOW_PASSES per sweep.
+    static constexpr size_t SEAM_PASS   = 0;
+    static constexpr size_t WINDOW_PASS = 1;
+    static constexpr size_t TILE_PASS   = 2;
+    static constexpr size_t FLOW_PASSES = 3;
+
+    template <size_t pass>
+    size_t offset(size_t local_offset) const {
+        return UT - local_offset - 2 * pass;
+    }
+
+    // Depth-first search for an augmenting path with an explicit stack in place
+    // of recursion. The current cell lives in locals; a parent is pushed with
+    // the direction it descended through, so the child's result is applied to
+    // that edge once the parent is popped. A bounded search does not enter
+    // cells outside [lx, rx] x [ly, ry] and leaves them to the next pass.
+    template <size_t pass, bool bounded = pass != SEAM_PASS>
     std::tuple<V_flow_t, bool, std::pair<int, int>> propagate_flow(
         int x, int y, V_flow_t lim, int lx = 0, int rx = 0, int ly = 0, int ry = 0) {
+        auto& state = search_stacks[worker_index];
+        auto& stack = state.flow;
+        auto& open  = geometry->open;
+        const auto use_step = neighbour_offsets(last_use);
 
-        last_use(x, y) = offset<edges>(1);
-
+        std::tuple<V_flow_t, bool, std::pair<int, int>> result;
         V_flow_t ret = 0;
-        for (auto [dx, dy] : deltas) {
-            int nx = x + dx, ny = y + dy;
-            if (field(nx, ny) != '#' && last_use(nx, ny) < offset<edges>(0)) {
-                auto cap  = velocity.get(x, y, dx, dy);
-                auto flow = velocity_flow.get(x, y, dx, dy);
-                if (flow == cap) {
-                    continue;
-                }
-
-                if constexpr (!edges) {
-                    if (!(lx <= nx && nx <= rx && ly <= ny && ny <= ry)) {
-                        edges_points.emplace_back(nx, ny);
+        size_t d     = 0;
+
+        ++flow_visit_count;
+        profiler.count(ProfileCounter::FLOW_CALLS, worker_index);
+        last_use(x, y) = offset<pass>(1);
+        while (true) {
+            bool found = false, descended = false;
+            uint8_t mask  = open(x, y);
+            size_t use_at = last_use.index(x, y);
+            for (; d < deltas.size(); ++d) {
+                auto [dx, dy] = deltas[d];
+                int nx = x + dx, ny = y + dy;
+                if ((mask & open_bits[d]) &&
+                    last_use.data[use_at + use_step[d]] < offset<pass>(0)) {
+                    auto cap  = velocity.get(x, y, dx, dy);
+                    auto flow = velocity_flow.get(x, y, dx, dy);
+                    if (flow == cap) {
                         continue;
                     }
-                }
 
-                auto vp = std::min(lim, static_cast<V_flow_t>(cap - flow));
-                if (last_use(nx, ny) == offset<edges>(1)) {
-                    velocity_flow.add(x, y, dx, dy, vp);
+                    if constexpr (bounded) {
+                        if (!(lx <= nx && nx <= rx && ly <= ny && ny <= ry)) {
+                            state.edges.emplace_back(nx, ny);
+                            continue;
+                        }
+                    }
 
-                    last_use(x, y) = offset<edges>(0);
+                    auto vp = std::min(lim, static_cast<V_flow_t>(cap - flow));
+                    if (last_use(nx, ny) == offset<pass>(1)) {
+                        if (flow_solver == FlowSolver::SATURATING) {
+                            vp = cycle_bottleneck(
+                                stack, static_cast<V_flow_t>(cap - flow), nx, ny);
+                        }
+                        velocity_flow.add(x, y, dx, dy, vp);
 
-                    return { vp, 1, { nx, ny } };
+                        last_use(x, y) = settled<pass>();
+
+                        result = { vp, 1, { nx, ny } };
+                        found  = true;
+                        break;
+                    }
+
+                    stack.push_back({ x, y, lim, ret, d });
+                    x   = nx;
+                    y   = ny;
+                    lim = vp;
+                    ret = 0;
+                    d   = 0;
+
+                    ++flow_visit_count;
+                    last_use(x, y) = offset<pass>(1);
+                    descended      = true;
+                    break;
                 }
+            }
+            if (descended) {
+                continue;
+            }
+            if (!found) {
+                last_use(x, y) = offset<pass>(0);
 
-                auto [t, prop, end] =
-                    propagate_flow<edges>(nx, ny, vp, lx, rx, ly, ry);
+                result = { ret, 0, { 0, 0 } };
+            }
 
+            // Hand the result up until a parent has directions left to try.
+            while (true) {
+                if (stack.empty()) {
+                    return result;
+                }
+                auto& f = stack.back();
+                x       = f.x;
+                y       = f.y;
+                lim     = f.lim;
+                ret     = f.ret;
+                d       = f.d;
+                stack.pop_back();
+
+                auto [t, prop, end] = result;
                 ret += t;
-                if (prop) {
-                    velocity_flow.add(x, y, dx, dy, t);
+                if (!prop) {
+                    ++d;
+                    break;
+                }
+                auto [dx, dy] = deltas[d];
+                velocity_flow.add(x, y, dx, dy, t);
 
-                    last_use(x, y) = offset<edges>(0);
+                last_use(x, y) = settled<pass>();
 
-                    return { t, prop && end != std::make_pair(x, y), end };
-                }
+                result = { t, prop && end != std::make_pair(x, y), end };
             }
         }
-        last_use(x, y) = offset<edges>(0);
+    }
 
-        return { ret, 0, { 0, 0 } };
+    // Mark of a cell on an augmented cycle. The saturating solver releases
+    // these cells, so the same sweep can search through them again.
+    template <size_t pass>
+    size_t settled() const {
+        return flow_solver == FlowSolver::SATURATING ? offset<pass>(2)
+                                                     : offset<pass>(0);
+    }
+
+    // Smallest residual capacity on the cycle that closes at (ex, ey); `last`
+    // is the residual of the edge closing it.
+    V_flow_t cycle_bottleneck(const std::vector<FlowFrame>& stack, V_flow_t last,
+                              int ex, int ey) {
+        for (auto f = stack.rbegin(); f != stack.rend(); ++f) {
+            auto [dx, dy] = deltas[f->d];
+            last = std::min(last, static_cast<V_flow_t>(
+                                      velocity.get(f->x, f->y, dx, dy) -
+                                      velocity_flow.get(f->x, f->y, dx, dy)));
+            if (f->x == ex && f->y == ey) {
+                break;
+            }
+        }
+        return last;
+    }
+
+    V_t random01(MoveContext& m) {
+        if (m.counter) {
+            return random01(m.rng);
+        }
+        return random01(rnd);
     }
 
-    inline auto random01() {
+    template <typename Rng>
+    V_t random01(Rng& rng) {
         if constexpr (std::is_floating_point_v<V_t>) {
-            return V_t{ dist(rnd) };
+            return V_t{ std::uniform_real_distribution<float>{ 0, 1 }(rng) };
         } else {
-            return V_t::random01(rnd());
+            return V_t::random01(rng());
         }
     }
 
-    void propagate_stop(int x, int y, bool force = false) {
-        if (!force) {
-            bool stop = true;
-            for (auto [dx, dy] : deltas) {
-                int nx = x + dx, ny = y + dy;
-                if (field(nx, ny) != '#' && last_use(nx, ny) < UT - 1 &&
-                    velocity.get(x, y, dx, dy) > 0) {
-                    stop = false;
-                    break;
+    void propagate_stop(MoveContext& m, int x, int y, bool force = false) {
+        auto& stack = search_stacks[worker_index].stop;
+
+        if (!stop_cell(m, x, y, force)) {
+            return;
+        }
+        size_t d = 0;
+        while (true) {
+            if (d == deltas.size()) {
+                if (stack.empty()) {
+                    return;
                 }
+                auto& f = stack.back();
+                x       = f.x;
+                y       = f.y;
+                d       = f.d;
+                stack.pop_back();
+                continue;
             }
-            if (!stop) {
-                return;
+            if (!(open_mask(x, y) & open_bits[d])) {
+                ++d;
+                continue;
             }
-        }
-        last_use(x, y) = UT;
-        for (auto [dx, dy] : deltas) {
+            auto [dx, dy] = deltas[d++];
             int nx = x + dx, ny = y + dy;
-            if (field(nx, ny) == '#' || last_use(nx, ny) == UT ||
-                velocity.get(x, y, dx, dy) > 0) {
+            if (last_use(nx, ny) == UT || velocity.get(x, y, dx, dy) > 0) {
                 continue;
             }
-            propagate_stop(nx, ny);
+            if (stop_cell(m, nx, ny, false)) {
+                stack.push_back({ x, y, d });
+                x = nx;
+                y = ny;
+                d = 0;
+            }
         }
     }
 
+    // Marks (x, y) as stopped unless it can still move somewhere; returns
+    // whether the flood goes on from it.
+    bool stop_cell(MoveContext& m, int x, int y, bool force) {
+        // A stop flood does not undo its chain at the tile edge, it goes on
+        // from there in the seam pass.
+        if (!inside(m, x, y)) {
+            m.stops.emplace_back(x, y);
+            return false;
+        }
+        if (!force) {
+            uint8_t mask = open_mask(x, y);
+            for (size_t d = 0; d < deltas.size(); ++d) {
+                auto [dx, dy] = deltas[d];
+                int nx = x + dx, ny = y + dy;
+                if ((mask & open_bits[d]) && last_use(nx, ny) < UT - 1 &&
+                    velocity.get(x, y, dx, dy) > 0) {
+                    return false;
+                }
+            }
+        }
+        set_last_use(m, x, y, UT);
+        return true;
+    }
+
     auto move_prob(int x, int y) {
-        V_t sum = 0;
+        V_t sum      = 0;
+        uint8_t mask = open_mask(x, y);
         for (size_t i = 0; i < deltas.size(); ++i) {
             auto [dx, dy] = deltas[i];
             int nx = x + dx, ny = y + dy;
-            if (field(nx, ny) == '#' || last_use(nx, ny) == UT) {
+            if (!(mask & open_bits[i]) || last_use(nx, ny) == UT) {
                 continue;
             }
             auto v = velocity.get(x, y, dx, dy);
@@ -411,17 +1600,26 @@ class FluidSim {
         return sum;
     }
 
-    bool propagate_move(int x, int y, bool is_first) {
-        last_use(x, y) = UT - is_first;
-        bool ret       = false;
+    // Random walk along positive velocities with an explicit stack. A cell
+    // whose chosen neighbour could not move picks again among the free ones;
+    // once the chain ends, every cell on it shifts one step towards its end.
+    bool propagate_move(MoveContext& m, int x, int y, bool is_first) {
+        auto& stack = search_stacks[worker_index].move;
+
+        if (!enter(m, x, y)) {
+            return false;
+        }
+        set_last_use(m, x, y, UT - is_first);
         int nx = -1, ny = -1;
-        do {
+        while (true) {
+            bool ret = false;
             std::array<V_t, deltas.size()> tres;
-            V_t sum = 0;
+            V_t sum      = 0;
+            uint8_t mask = open_mask(x, y);
             for (size_t i = 0; i < deltas.size(); ++i) {
                 auto [dx, dy] = deltas[i];
                 int nx = x + dx, ny = y + dy;
-                if (field(nx, ny) == '#' || last_use(nx, ny) == UT) {
+                if (!(mask & open_bits[i]) || last_use(nx, ny) == UT) {
                     tres[i] = sum;
                     continue;
                 }
@@ -434,41 +1632,68 @@ class FluidSim {
                 tres[i] = sum;
             }
 
-            if (sum == 0) {
-                break;
-            }
+            if (sum != 0) {
+                V_t p    = random01(m) * sum;
+                size_t d = std::ranges::upper_bound(tres, p) - tres.begin();
 
-            V_t p    = random01() * sum;
-            size_t d = std::ranges::upper_bound(tres, p) - tres.begin();
+                auto [dx, dy] = deltas[d];
+                nx            = x + dx;
+                ny            = y + dy;
+                assert(velocity.get(x, y, dx, dy) > 0 && field(nx, ny) != '#' &&
+                       last_use(nx, ny) < UT);
 
-            auto [dx, dy] = deltas[d];
-            nx            = x + dx;
-            ny            = y + dy;
-            assert(velocity.get(x, y, dx, dy) > 0 && field(nx, ny) != '#' &&
-                   last_use(nx, ny) < UT);
-
-            ret = (last_use(nx, ny) == UT - 1 || propagate_move(nx, ny, false));
-        } while (!ret);
-        last_use(x, y) = UT;
-        for (size_t i = 0; i < deltas.size(); ++i) {
-            auto [dx, dy] = deltas[i];
-            int nx = x + dx, ny = y + dy;
-            if (field(nx, ny) != '#' && last_use(nx, ny) < UT - 1 &&
-                velocity.get(x, y, dx, dy) < 0) {
-                propagate_stop(nx, ny);
+                if (last_use(nx, ny) != UT - 1) {
+                    if (!enter(m, nx, ny)) {
+                        stack.clear();
+                        return false;
+                    }
+                    stack.push_back({ x, y, nx, ny, is_first });
+                    x        = nx;
+                    y        = ny;
+                    is_first = false;
+                    set_last_use(m, x, y, UT);
+                    continue;
+                }
+                ret = true;
             }
-        }
-        if (ret) {
-            if (!is_first) {
-                swap_with(x, y, nx, ny);
+
+            // Finish cells up the chain until one has to choose again.
+            while (true) {
+                set_last_use(m, x, y, UT);
+                uint8_t mask = open_mask(x, y);
+                for (size_t i = 0; i < deltas.size(); ++i) {
+                    auto [dx, dy] = deltas[i];
+                    int nx = x + dx, ny = y + dy;
+                    if ((mask & open_bits[i]) && last_use(nx, ny) < UT - 1 &&
+                        velocity.get(x, y, dx, dy) < 0) {
+                        propagate_stop(m, nx, ny);
+                    }
+                }
+                if (ret) {
+                    if (!is_first) {
+                        move_cell(m, x, y, nx, ny);
+                    }
+                }
+                if (stack.empty()) {
+                    return ret;
+                }
+                auto& f  = stack.back();
+                x        = f.x;
+                y        = f.y;
+                nx       = f.nx;
+                ny       = f.ny;
+                is_first = f.is_first;
+                stack.pop_back();
+                if (!ret) {
+                    break;
+                }
             }
         }
-        return ret;
     }
 
     void for_each_cell(auto&& func) {
-        for (size_t x = 1; x < rows - 1; ++x) {
-            for (size_t y = 1; y < cols - 1; ++y) {
+        for (size_t x = 1; x < field_rows() - 1; ++x) {
+            for (size_t y = 1; y < field_cols() - 1; ++y) {
                 func(x, y);
             }
         }
@@ -479,32 +1704,184 @@ class FluidSim {
         { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } }
     };
 
+    static constexpr size_t dir_index(int dx, int dy) {
+        return ((dy & 1) << 1) |
+               (((dx & 1) & ((dx & 2) >> 1)) | ((dy & 1) & ((dy & 2) >> 1)));
+    }
+
+    // Linear offsets of the neighbours of a cell in `a`, in the order of
+    // `deltas`: ±stride and ±1, known at compile time for a static Size.
+    template <typename T>
+    static std::array<ptrdiff_t, deltas.size()> neighbour_offsets(
+        const Arr_t<T>& a) {
+        if constexpr (is_static<Size>) {
+            return static_neighbour_offsets<T>;
+        } else {
+            return linear_offsets(a.row_stride());
+        }
+    }
+
+    static constexpr std::array<ptrdiff_t, deltas.size()> linear_offsets(
+        size_t stride) {
+        std::array<ptrdiff_t, deltas.size()> offsets{};
+        for (size_t d = 0; d < deltas.size(); ++d) {
+            offsets[d] = deltas[d].first * static_cast<ptrdiff_t>(stride) +
+                         deltas[d].second;
+        }
+        return offsets;
+    }
+
+    template <typename T>
+    static constexpr auto static_neighbour_offsets =
+        linear_offsets(Arr_t<T>::static_stride);
+
+    // Bits of the open mask for the neighbours in the order of `deltas`.
+    static constexpr auto open_bits = [] {
+        std::array<uint8_t, deltas.size()> bits{};
+        for (size_t d = 0; d < deltas.size(); ++d) {
+            bits[d] = simd::open_bit(dir_index(deltas[d].first, deltas[d].second));
+        }
+        return bits;
+    }();
+
+    // 1 / n for the open neighbour counts, in the type of the divided value.
+    template <typename T>
+    static constexpr auto dirs_reciprocals = [] {
+        std::array<Reciprocal<T>, deltas.size() + 1> table{};
+        for (size_t n = 0; n < table.size(); ++n) {
+            table[n] = Reciprocal<T>{ T(static_cast<int>(n)) };
+        }
+        return table;
+    }();
+
+    // Walls never move, so the wall checks of the per-tick loops read the
+    // open mask built with the geometry instead of the field: one load per
+    // cell instead of one per neighbour.
+    uint8_t open_mask(size_t x, size_t y) const {
+        return geometry->open(x, y);
+    }
+
+    // Calls func.template operator()<dx, dy>() for every direction of
+    // `deltas`, unrolled, so neighbour accesses get constant offsets.
+    static void for_each_delta(auto&& func) {
+        [&]<size_t... d>(std::index_sequence<d...>) {
+            (func.template operator()<deltas[d].first, deltas[d].second>(), ...);
+        }(std::make_index_sequence<deltas.size()>{});
+    }
+
+    static constexpr size_t flow_tile_count(size_t rows, size_t cols) {
+        return (rows + FLOW_TILE - 1) / FLOW_TILE *
+               ((cols + FLOW_TILE - 1) / FLOW_TILE);
+    }
+
+    static constexpr auto tile_layout(size_t rows, size_t cols) {
+        std::vector<simd::Region> tiles;
+        for (size_t x0 = 0; x0 < rows; x0 += FLOW_TILE) {
+            for (size_t y0 = 0; y0 < cols; y0 += FLOW_TILE) {
+                tiles.push_back({ x0, std::min(rows, x0 + FLOW_TILE - 1), y0,
+                                  std::min(cols, y0 + FLOW_TILE - 1) });
+            }
+        }
+        return tiles;
+    }
+
+    // The separated tiles of a static size, laid out at compile time.
+    static constexpr auto static_flow_tiles = [] {
+        std::array<simd::Region, flow_tile_count(Size::rows, Size::cols)> tiles{};
+        auto layout = tile_layout(Size::rows, Size::cols);
+        std::copy(layout.begin(), layout.end(), tiles.begin());
+        return tiles;
+    }();
+
     template <typename T>
     struct VectorField {
+        using Cell   = std::array<T, deltas.size()>;
+        using Planes = StaticSize<Size::rows * deltas.size(), Size::cols>;
+        using Storage =
+            std::conditional_t<Layout::planar,
+                               Array2d<T, Planes, typename Layout::Rows>,
+                               Arr_t<Cell>>;
+
         VectorField(size_t rows, size_t cols)
-            : v{ rows, cols } {
+            : rows(rows),
+              v(Layout::planar ? rows * deltas.size() : rows, cols) {
         }
 
-        Arr_t<std::array<T, deltas.size()>> v;
+        size_t rows;
+        Storage v;
 
         T& add(int x, int y, int dx, int dy, auto dv) {
             return get(x, y, dx, dy) += dv;
         }
 
         T& get(int x, int y, int dx, int dy) {
-            return v(x, y)[((dy & 1) << 1) | (((dx & 1) & ((dx & 2) >> 1)) |
-                                              ((dy & 1) & ((dy & 2) >> 1)))];
+            return get(x, y, dir_index(dx, dy));
+        }
+
+        T& get(size_t x, size_t y, size_t d) {
+            if constexpr (!Layout::planar) {
+                return v(x, y)[d];
+            } else if constexpr (is_static<Size>) {
+                return v(d * Size::rows + x, y);
+            } else {
+                return v(d * rows + x, y);
+            }
+        }
+
+        const T& get(size_t x, size_t y, size_t d) const {
+            return const_cast<VectorField*>(this)->get(x, y, d);
+        }
+
+        Cell cell(size_t x, size_t y) const {
+            if constexpr (!Layout::planar) {
+                return v(x, y);
+            } else {
+                Cell ret;
+                for (size_t d = 0; d < ret.size(); ++d) {
+                    ret[d] = get(x, y, d);
+                }
+                return ret;
+            }
+        }
+
+        void set_cell(size_t x, size_t y, const Cell& value) {
+            for (size_t d = 0; d < value.size(); ++d) {
+                get(x, y, d) = value[d];
+            }
+        }
+
+        void swap_cells(size_t x, size_t y, size_t nx, size_t ny) {
+            if constexpr (!Layout::planar) {
+                std::swap(v(x, y), v(nx, ny));
+            } else {
+                for (size_t d = 0; d < deltas.size(); ++d) {
+                    std::swap(get(x, y, d), get(nx, ny, d));
+                }
+            }
+        }
+
+        void clear() {
+            v.clear();
         }
     };
 
+    using VelocityCell = typename VectorField<V_t>::Cell;
+
     size_t num_workers;
-    std::barrier<> start_point;
-    std::barrier<> end_point;
-    std::vector<std::thread> threads;
-    std::vector<std::pair<std::pair<size_t, size_t>, std::pair<size_t, size_t>>>
-        borders;
-    ConcurrentVector<std::pair<size_t, size_t>> edges_points;
-    bool prop;
+    WorkerPool& pool;
+    std::vector<simd::Region> flow_tiles;
+    std::vector<uint64_t> flow_cost;
+    std::vector<uint64_t> flow_visits;
+    TileScheduler flow_scheduler;
+    [[no_unique_address]] Profiler<> profiler;
+    static inline thread_local size_t flow_visit_count = 0;
+    // Index of the worker running on this thread; the calling thread is 0.
+    static inline thread_local size_t worker_index = 0;
+    std::vector<SearchStacks> search_stacks;
+    CellBitmap seam_cells;
+    // Set by any worker whose search moved flow; the end of the phase orders
+    // these stores before the check after the sweep.
+    std::atomic<bool> prop{ false };
 
     size_t rows;
     size_t cols;
@@ -514,20 +1891,185 @@ class FluidSim {
     Arr_t<P_t> p;
     Arr_t<P_t> old_p;
     std::array<P_t, 256> rho{};
+    std::array<Reciprocal<P_t>, 256> rho_reciprocals{};
     VectorField<V_t> velocity;
     VectorField<V_flow_t> velocity_flow;
     Arr_t<int> last_use;
     int UT{};
-    std::mt19937 rnd{ 1337 };
-    std::uniform_real_distribution<float> dist{ 0, 1 };
-    Arr_t<int> dirs;
+    uint64_t seed{ DEFAULT_SEED };
+    std::mt19937 rnd{ DEFAULT_SEED };
+    RngMode rng_mode{ RngMode::MT19937 };
+    FlowSolver flow_solver{ FlowSolver::UNIT };
+    FrameOutput frame_output;
+    FrameWriter frame_writer;
+    std::unique_ptr<TrajectoryWriter> trajectory;
+    std::vector<char> trajectory_field;
+    std::vector<P_t> trajectory_p;
+    std::vector<VelocityCell> trajectory_velocity;
+    double rest_threshold = 0;
+    size_t active_rows    = 0;
+    size_t active_cols    = 0;
+    std::vector<uint8_t> tile_quiet;
+    std::vector<uint8_t> tile_skip;
+    std::vector<uint8_t> tile_moved;
+    std::vector<double> skip_ratios;
+    size_t flow_sweep_count  = 0;
+    size_t window_seam_count = 0;
+    size_t serial_seam_count = 0;
+    std::vector<MoveContext> move_tiles;
+    std::vector<std::pair<size_t, size_t>> seam_moves;
+    std::vector<std::pair<size_t, size_t>> seam_stops;
+    std::shared_ptr<Geometry> geometry;
     static constexpr size_t TICKS = 1'00;
+    size_t tick_limit             = TICKS;
     V_t g;
 
+    CheckpointHandler checkpoint_handler;
+    std::atomic<bool> checkpoint_requested{ false };
+    bool periodic_requested{ false };
+    size_t checkpoint_every{};
+    std::unique_ptr<Snapshot> snapshot;
+    std::mutex checkpoint_mutex;
+    std::condition_variable checkpoint_cv;
+    bool checkpoint_ready{ false };
+    bool checkpoint_stop{ false };
+    std::thread checkpoint_writer;
+
+    // Active tiles nest in the move tiles, so in counter mode a tile's flag
+    // is only written by the worker that owns the enclosing move tile.
     void swap_with(int x, int y, int nx, int ny) {
+        if (rest_threshold > 0) {
+            tile_moved[active_tile(x, y)] = 1;
+            tile_moved[active_tile(nx, ny)] = 1;
+        }
         std::swap(field(x, y), field(nx, ny));
         std::swap(p(x, y), p(nx, ny));
-        std::swap(velocity.v(x, y), velocity.v(nx, ny));
+        velocity.swap_cells(x, y, nx, ny);
     }
+
+    void record_trajectory() {
+        for_each_cell({ 0, rows, 0, cols }, [&](size_t x, size_t y) {
+            trajectory_field[x * cols + y] = field(x, y);
+        });
+        if (!trajectory_p.empty()) {
+            for_each_cell({ 0, rows, 0, cols }, [&](size_t x, size_t y) {
+                trajectory_p[x * cols + y] = p(x, y);
+            });
+        }
+        if (!trajectory_velocity.empty()) {
+            for_each_cell({ 0, rows, 0, cols }, [&](size_t x, size_t y) {
+                trajectory_velocity[x * cols + y] = velocity.cell(x, y);
+            });
+        }
+
+        std::array<std::span<const std::byte>, 3> cells;
+        size_t streams = 0;
+        cells[streams++] = std::as_bytes(std::span{ trajectory_field });
+        if (!trajectory_p.empty()) {
+            cells[streams++] = std::as_bytes(std::span{ trajectory_p });
+        }
+        if (!trajectory_velocity.empty()) {
+            cells[streams++] = std::as_bytes(std::span{ trajectory_velocity });
+        }
+        trajectory->record(tick, std::span{ cells }.first(streams));
+    }
+
+    template <typename T>
+    static bool same_bytes(const T& a, const T& b) {
+        return std::memcmp(&a, &b, sizeof(T)) == 0;
+    }
+
+  public:
+    // Copy of the state taken at a tick boundary, written out by the
+    // checkpoint thread while the simulation keeps running.
+    struct Snapshot {
+        Snapshot(size_t rows, size_t cols)
+            : rows{ rows },
+              cols{ cols },
+              field{ rows, cols },
+              p{ rows, cols },
+              old_p{ rows, cols },
+              velocity{ rows, cols },
+              velocity_flow{ rows, cols },
+              last_use{ rows, cols },
+              dirs{ rows, cols } {
+        }
+
+        void capture(const FluidSim& sim) {
+            tick                 = sim.tick;
+            UT                   = sim.UT;
+            seed                 = sim.seed;
+            rnd                  = sim.rnd;
+            field.data           = sim.field.data;
+            p.data               = sim.p.data;
+            old_p.data           = sim.old_p.data;
+            velocity.v.data      = sim.velocity.v.data;
+            velocity_flow.v.data = sim.velocity_flow.v.data;
+            last_use.data        = sim.last_use.data;
+            dirs.data            = sim.geometry->dirs.data;
+            rho                  = sim.rho;
+            g                    = sim.g;
+        }
+
+        void serialize(std::ostream& file) const {
+            write_json(file, *this);
+        }
+
+        void serialize_binary(std::ostream& file, CheckpointHeader header) const {
+            write_binary(file, header, *this);
+        }
+
+        // Stores only the cells whose field, p or velocity differ from `base`.
+        // old_p, velocity_flow and last_use are rebuilt by the next tick
+        // before they are read, so a delta does not need them.
+        void serialize_delta(std::ostream& file, CheckpointHeader header,
+                             const Snapshot& base, std::string_view parent) const {
+            std::vector<uint32_t> cells;
+            std::vector<char> cell_field;
+            std::vector<P_t> cell_p;
+            std::vector<VelocityCell> cell_velocity;
+
+            for (size_t x = 0; x < rows; ++x) {
+                for (size_t y = 0; y < cols; ++y) {
+                    if (field(x, y) != base.field(x, y) ||
+                        !same_bytes(p(x, y), base.p(x, y)) ||
+                        !same_bytes(velocity.cell(x, y), base.velocity.cell(x, y))) {
+                        cells.push_back(x * cols + y);
+                        cell_field.push_back(field(x, y));
+                        cell_p.push_back(p(x, y));
+                        cell_velocity.push_back(velocity.cell(x, y));
+                    }
+                }
+            }
+
+            fill_header(header, *this);
+            header.kind = CheckpointKind::DELTA;
+
+            CheckpointWriter writer{ file, header };
+            writer.add(SectionId::CELLS, cells);
+            writer.add(SectionId::FIELD, cell_field);
+            writer.add(SectionId::P, cell_p);
+            writer.add(SectionId::VELOCITY, cell_velocity);
+            writer.add(SectionId::PARENT, parent);
+            writer.finish();
+        }
+
+        bool periodic{};
+        size_t rows;
+        size_t cols;
+        size_t tick{};
+        int UT{};
+        uint64_t seed{};
+        std::mt19937 rnd;
+        Arr_t<char> field;
+        Arr_t<P_t> p;
+        Arr_t<P_t> old_p;
+        std::array<P_t, 256> rho{};
+        VectorField<V_t> velocity;
+        VectorField<V_flow_t> velocity_flow;
+        Arr_t<int> last_use;
+        Arr_t<int> dirs;
+        V_t g;
+    };
 };
 } // namespace Fluid
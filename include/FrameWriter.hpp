@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Fluid {
+
+// ascii prints every frame whole. delta prints the first frame whole
+// ("Tick N: full") and then only the runs of cells that changed since the
+// previous written frame ("Tick N: delta K" and K lines "row col cells").
+enum class FrameFormat {
+    ASCII,
+    DELTA
+};
+
+inline FrameFormat parse_frame_format(std::string_view name) {
+    if (name == "ascii") {
+        return FrameFormat::ASCII;
+    }
+    if (name == "delta") {
+        return FrameFormat::DELTA;
+    }
+    throw std::runtime_error("Error: Unknown frame format: " + std::string{ name });
+}
+
+// Which frames run() writes: none, every tick with a move (ascii), or only
+// the ticks with a move that are multiples of N (every-N), and how. With
+// ring > 0 frames are queued for a writer thread; a full queue makes the
+// simulation wait, or drops the frame if drop_when_full is set.
+struct FrameOutput {
+    bool enabled        = true;
+    size_t every        = 1;
+    FrameFormat format  = FrameFormat::ASCII;
+    size_t ring         = 4;
+    bool drop_when_full = false;
+
+    bool wants(size_t tick) const {
+        return enabled && tick % every == 0;
+    }
+};
+
+inline FrameOutput parse_frame_output(std::string_view name) {
+    FrameOutput output;
+    if (name == "none") {
+        output.enabled = false;
+        return output;
+    }
+    if (name == "ascii") {
+        return output;
+    }
+    if (name.starts_with("every-")) {
+        std::string n{ name.substr(6) };
+        size_t used = 0;
+        try {
+            output.every = std::stoul(n, &used);
+        } catch (const std::logic_error&) {
+        }
+        if (!n.empty() && used == n.size() && n[0] != '-' && output.every > 0) {
+            return output;
+        }
+    }
+    throw std::runtime_error("Error: Unknown output mode: " + std::string{ name });
+}
+
+// A copy of the field taken at the end of a tick, rows * cols cells.
+struct Frame {
+    size_t tick = 0;
+    std::vector<char> cells;
+};
+
+// Turns frames into text. The buffers keep their capacity, so after the
+// first frame nothing is allocated.
+class FrameEncoder {
+  public:
+    FrameEncoder(FrameFormat format, size_t rows, size_t cols)
+        : format(format),
+          rows(rows),
+          cols(cols) {
+    }
+
+    const std::string& encode(const Frame& frame) {
+        text.clear();
+        text += "Tick ";
+        text += std::to_string(frame.tick);
+        if (format == FrameFormat::ASCII) {
+            text += ":\n";
+            append_rows(frame);
+        } else if (previous.empty()) {
+            text += ": full\n";
+            append_rows(frame);
+            previous = frame.cells;
+        } else {
+            append_delta(frame);
+        }
+        return text;
+    }
+
+  private:
+    void append_rows(const Frame& frame) {
+        size_t header = text.size();
+        text.resize(header + rows * (cols + 1));
+        char* pos = text.data() + header;
+        for (size_t x = 0; x < rows; ++x) {
+            pos = std::copy_n(frame.cells.data() + x * cols, cols, pos);
+            *pos++ = '\n';
+        }
+    }
+
+    void append_delta(const Frame& frame) {
+        runs.clear();
+        size_t count = 0;
+        for (size_t x = 0; x < rows; ++x) {
+            const char* now = frame.cells.data() + x * cols;
+            char* before    = previous.data() + x * cols;
+            for (size_t y = 0; y < cols;) {
+                if (now[y] == before[y]) {
+                    ++y;
+                    continue;
+                }
+                size_t start = y;
+                for (; y < cols && now[y] != before[y]; ++y) {
+                    before[y] = now[y];
+                }
+                runs += std::to_string(x);
+                runs += ' ';
+                runs += std::to_string(start);
+                runs += ' ';
+                runs.append(now + start, y - start);
+                runs += '\n';
+                ++count;
+            }
+        }
+        text += ": delta ";
+        text += std::to_string(count);
+        text += '\n';
+        text += runs;
+    }
+
+    FrameFormat format;
+    size_t rows;
+    size_t cols;
+    std::string text;
+    std::string runs;
+    std::vector<char> previous;
+};
+
+// Writes the frames of one run(). Queued frames are encoded and written by
+// a thread of their own, one write per frame, in tick order.
+class FrameWriter {
+  public:
+    FrameWriter() = default;
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    ~FrameWriter() {
+        finish();
+    }
+
+    void start(std::ostream& out, const FrameOutput& output, size_t rows,
+               size_t cols) {
+        finish();
+        this->out    = &out;
+        this->output = output;
+        encoder.emplace(output.format, rows, cols);
+        dropped = 0;
+        head    = 0;
+        tail    = 0;
+        queued  = 0;
+        done    = false;
+        if (!output.enabled) {
+            return;
+        }
+        slots.resize(std::max<size_t>(output.ring, 1));
+        for (auto&& slot : slots) {
+            slot.cells.resize(rows * cols);
+        }
+        if (output.ring > 0) {
+            writer = std::thread([this] {
+                write_loop();
+            });
+        }
+    }
+
+    // Copies the field into the next free slot. Only waits when the ring
+    // is full and the policy is to block.
+    template <typename Field>
+    void write(size_t tick, const Field& field, size_t rows, size_t cols) {
+        if (!writer.joinable()) {
+            copy(slots[0], tick, field, rows, cols);
+            auto&& text = encoder->encode(slots[0]);
+            out->write(text.data(), text.size());
+            return;
+        }
+
+        std::unique_lock lock{ mutex };
+        if (queued == slots.size()) {
+            if (output.drop_when_full) {
+                ++dropped;
+                return;
+            }
+            not_full.wait(lock, [&] {
+                return queued < slots.size();
+            });
+        }
+        // The writer does not touch the slot at head until it is queued.
+        lock.unlock();
+        copy(slots[head], tick, field, rows, cols);
+        lock.lock();
+        head = (head + 1) % slots.size();
+        ++queued;
+        not_empty.notify_one();
+    }
+
+    // Waits until every queued frame is written.
+    void finish() {
+        if (!writer.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard lock{ mutex };
+            done = true;
+        }
+        not_empty.notify_one();
+        writer.join();
+    }
+
+    // Frames the last run() dropped because the ring was full.
+    size_t dropped_frames() const {
+        return dropped;
+    }
+
+  private:
+    template <typename Field>
+    static void copy(Frame& frame, size_t tick, const Field& field, size_t rows,
+                     size_t cols) {
+        frame.tick = tick;
+        char* pos  = frame.cells.data();
+        for (size_t x = 0; x < rows; ++x) {
+            for (size_t y = 0; y < cols; ++y) {
+                *pos++ = field(x, y);
+            }
+        }
+    }
+
+    void write_loop() {
+        std::unique_lock lock{ mutex };
+        while (true) {
+            not_empty.wait(lock, [&] {
+                return queued > 0 || done;
+            });
+            if (queued == 0) {
+                return;
+            }
+            // The slot at tail stays ours until queued drops.
+            lock.unlock();
+            auto&& text = encoder->encode(slots[tail]);
+            out->write(text.data(), text.size());
+            lock.lock();
+            tail = (tail + 1) % slots.size();
+            --queued;
+            not_full.notify_one();
+        }
+    }
+
+    std::ostream* out = nullptr;
+    FrameOutput output;
+    std::optional<FrameEncoder> encoder;
+    std::vector<Frame> slots;
+    size_t head    = 0;
+    size_t tail    = 0;
+    size_t queued  = 0;
+    size_t dropped = 0;
+    bool done      = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::thread writer;
+};
+
+} // namespace Fluid
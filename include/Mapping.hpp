@@ -1,9 +1,11 @@
 #pragma once
 
+#include "Checkpoint.hpp"
 #include "FluidSim.hpp"
 #include "Types.hpp"
 #include <array>
 #include <csignal>
+#include <functional>
 #include <string>
 #include <string_view>
 
@@ -114,11 +116,6 @@ class Mapper {
     }
 
 
-static std::function<void(int)> shutdown_handler;
-static void signal_handler(int signal) {
-    shutdown_handler(signal);
-}
-
   public:
     Mapper() = default;
 
@@ -142,6 +139,16 @@ static void signal_handler(int signal) {
     }
 
     explicit Mapper(const std::string& load_path) {
+        if (Fluid::CheckpointReader::is_checkpoint(load_path)) {
+            Fluid::CheckpointReader reader{ load_path };
+            auto& header  = reader.header();
+            m_p_type      = header.p_type.data();
+            m_v_type      = header.v_type.data();
+            m_v_flow_type = header.v_flow_type.data();
+            m_rows        = header.rows;
+            m_cols        = header.cols;
+            return;
+        }
         std::ifstream file(load_path);
         assert(file.is_open());
         file >> m_p_type >> m_v_type >> m_v_flow_type >> m_rows >> m_cols;
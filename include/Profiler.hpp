@@ -0,0 +1,232 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Fluid {
+
+// Built with -DFLUID_PROFILE=ON, every tick records its phase times and
+// counters; otherwise the profiler is an empty class whose calls compile to
+// nothing.
+#ifdef FLUID_PROFILE
+inline constexpr bool profile_enabled = true;
+#else
+inline constexpr bool profile_enabled = false;
+#endif
+
+// make_flow_from_vel is split into the parallel tile sweeps and the seam
+// passes over the cells the tiles could not enter.
+enum class ProfilePhase : size_t {
+    EXTERNAL_FORCES,
+    P_FORCES,
+    FLOW_SWEEP,
+    FLOW_SEAMS,
+    RECALC_P,
+    MAKE_STEP,
+    COUNT
+};
+
+enum class ProfileCounter : size_t {
+    FLOW_SWEEPS,
+    FLOW_CALLS,
+    EDGE_POINTS,
+    MOVED_CELLS,
+    COUNT
+};
+
+inline constexpr std::array<std::string_view, size_t(ProfilePhase::COUNT)>
+    profile_phase_names{ "apply_external_forces", "apply_p_forces", "flow_sweep",
+                         "flow_seams",            "recalc_p",       "make_step" };
+
+inline constexpr std::array<std::string_view, size_t(ProfileCounter::COUNT)>
+    profile_counter_names{ "flow_sweeps", "propagate_flow_calls", "edge_points",
+                           "moved_cells" };
+
+struct TickProfile {
+    size_t tick = 0;
+    std::array<uint64_t, size_t(ProfilePhase::COUNT)> phase_ns{};
+    std::array<uint64_t, size_t(ProfileCounter::COUNT)> counters{};
+    // Time each worker spent at the end of pool phases waiting for the rest.
+    std::vector<uint64_t> wait_ns;
+};
+
+template <bool Enabled = profile_enabled>
+class Profiler;
+
+template <>
+class Profiler<false> {
+  public:
+    explicit Profiler(size_t) {
+    }
+
+    void begin_tick(size_t) {
+    }
+
+    void end_tick() {
+    }
+
+    decltype(auto) time(ProfilePhase, auto&& func) {
+        return func();
+    }
+
+    void count(ProfileCounter, size_t, uint64_t = 1) {
+    }
+
+    void job_done(size_t) {
+    }
+
+    void phase_done() {
+    }
+};
+
+template <>
+class Profiler<true> {
+    using Clock = std::chrono::steady_clock;
+
+  public:
+    explicit Profiler(size_t workers)
+        : slots(workers) {
+    }
+
+    void begin_tick(size_t tick) {
+        current      = TickProfile{};
+        current.tick = tick;
+        current.wait_ns.assign(slots.size(), 0);
+        for (auto&& slot : slots) {
+            slot.counters.fill(0);
+        }
+    }
+
+    void end_tick() {
+        for (auto&& slot : slots) {
+            for (size_t c = 0; c < slot.counters.size(); ++c) {
+                current.counters[c] += slot.counters[c];
+            }
+        }
+        history.push_back(std::move(current));
+    }
+
+    decltype(auto) time(ProfilePhase phase, auto&& func) {
+        struct Timer {
+            uint64_t& total;
+            Clock::time_point start = Clock::now();
+
+            ~Timer() {
+                total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - start)
+                             .count();
+            }
+        } timer{ current.phase_ns[size_t(phase)] };
+        return func();
+    }
+
+    // Counters are kept per worker, so workers never share a cache line.
+    void count(ProfileCounter counter, size_t worker, uint64_t n = 1) {
+        slots[worker].counters[size_t(counter)] += n;
+    }
+
+    // Called by each worker when its part of a pool phase is done, then by
+    // the caller once all of them are.
+    void job_done(size_t worker) {
+        slots[worker].done = Clock::now();
+    }
+
+    void phase_done() {
+        auto now = Clock::now();
+        for (size_t w = 0; w < slots.size(); ++w) {
+            current.wait_ns[w] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - slots[w].done)
+                    .count();
+        }
+    }
+
+    const std::vector<TickProfile>& ticks() const {
+        return history;
+    }
+
+    // JSON for a path ending in .json, CSV otherwise.
+    void write(const std::string& path) const {
+        std::ofstream file{ path };
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open " + path + " for writing");
+        }
+        if (path.ends_with(".json")) {
+            write_json(file);
+        } else {
+            write_csv(file);
+        }
+        if (!file.flush()) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+
+  private:
+    void write_csv(std::ostream& out) const {
+        out << "tick";
+        for (auto name : profile_phase_names) {
+            out << ',' << name << "_ns";
+        }
+        for (auto name : profile_counter_names) {
+            out << ',' << name;
+        }
+        for (size_t w = 0; w < slots.size(); ++w) {
+            out << ",wait_w" << w << "_ns";
+        }
+        out << '\n';
+
+        for (auto&& t : history) {
+            out << t.tick;
+            for (auto ns : t.phase_ns) {
+                out << ',' << ns;
+            }
+            for (auto n : t.counters) {
+                out << ',' << n;
+            }
+            for (auto ns : t.wait_ns) {
+                out << ',' << ns;
+            }
+            out << '\n';
+        }
+    }
+
+    void write_json(std::ostream& out) const {
+        nlohmann::json json;
+        json["workers"] = slots.size();
+        json["ticks"]   = nlohmann::json::array();
+        for (auto&& t : history) {
+            nlohmann::json tick;
+            tick["tick"] = t.tick;
+            for (size_t p = 0; p < t.phase_ns.size(); ++p) {
+                std::string name{ profile_phase_names[p] };
+                tick["phase_ns"][name] = t.phase_ns[p];
+            }
+            for (size_t c = 0; c < t.counters.size(); ++c) {
+                std::string name{ profile_counter_names[c] };
+                tick["counters"][name] = t.counters[c];
+            }
+            tick["wait_ns"] = t.wait_ns;
+            json["ticks"].push_back(std::move(tick));
+        }
+        out << json.dump(1) << '\n';
+    }
+
+    struct alignas(64) Slot {
+        std::array<uint64_t, size_t(ProfileCounter::COUNT)> counters{};
+        Clock::time_point done{};
+    };
+
+    std::vector<Slot> slots;
+    TickProfile current;
+    std::vector<TickProfile> history;
+};
+
+} // namespace Fluid
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "Batch.hpp"
+#include "Checkpoint.hpp"
+#include "FluidSim.hpp"
+#include "Mapping.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Command line of one run; for a batch, also its manifest.
+struct Parsed {
+    enum class Type {
+        READ_FIELD,
+        LOAD_SAVE,
+        BATCH
+    };
+    enum class Format {
+        BINARY,
+        JSON
+    };
+    Type type;
+    Format save_format = Format::BINARY;
+    std::string p_type;
+    std::string v_type;
+    std::string v_flow_type;
+    std::string field_path;
+    std::string load_path;
+    std::string batch_path;
+    std::string profile_out;
+    std::string frames_out;
+    std::string trajectory_path;
+    Fluid::Manifest manifest;
+    std::optional<size_t> num_threads;
+    std::optional<size_t> ticks;
+    std::optional<uint64_t> seed;
+    std::optional<std::vector<unsigned>> pin_cpus;
+    size_t checkpoint_every       = 0;
+    uint32_t trajectory_streams   = Fluid::TRAJECTORY_FIELD;
+    size_t keyframe_every         = 64;
+    Fluid::simd::Isa simd         = Fluid::simd::Isa::SCALAR;
+    Fluid::RngMode rng_mode       = Fluid::RngMode::MT19937;
+    Fluid::FlowSolver flow_solver = Fluid::FlowSolver::UNIT;
+    Fluid::FrameOutput output;
+    double rest_threshold         = 0;
+    bool flow_stats               = false;
+};
+
+// The running simulation's checkpoint request flag. The handler only stores
+// to it, which keeps it async-signal-safe.
+inline std::atomic<std::atomic<bool>*> checkpoint_flag{ nullptr };
+static_assert(std::atomic<std::atomic<bool>*>::is_always_lock_free &&
+              std::atomic<bool>::is_always_lock_free);
+
+inline void signal_handler(int signal) {
+    auto* flag = checkpoint_flag.load(std::memory_order_relaxed);
+    if (signal == SIGINT && flag != nullptr) {
+        flag->store(true, std::memory_order_relaxed);
+    }
+}
+
+// Runs one simulation as the command line asks. Returns the exit status.
+template <typename Sim>
+int run_simulation(const Parsed& parsed, const Mapper& mapped) {
+    Sim sim(mapped.get_rows(), mapped.get_cols(), parsed.num_threads.value_or(1));
+    try {
+        if (parsed.type == Parsed::Type::LOAD_SAVE) {
+            if (Fluid::CheckpointReader::is_checkpoint(parsed.load_path)) {
+                for (auto&& path : Fluid::checkpoint_chain(parsed.load_path)) {
+                    Fluid::CheckpointReader reader{ path };
+                    sim.deserialize_binary(reader);
+                }
+            } else {
+                std::ifstream file(parsed.load_path);
+                assert(file.is_open());
+                file.ignore(std::numeric_limits<std::streamsize>::max(),
+                            file.widen('\n'));
+                sim.deserialize(file);
+            }
+        } else {
+            sim.read_field(parsed.field_path);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    Fluid::DeltaCheckpointer<typename Sim::Snapshot> periodic;
+    sim.set_checkpoint_every(parsed.checkpoint_every);
+    sim.set_rng_mode(parsed.rng_mode);
+    sim.set_flow_solver(parsed.flow_solver);
+    sim.set_frame_output(parsed.output);
+    if (parsed.ticks.has_value()) {
+        sim.set_tick_limit(parsed.ticks.value());
+    }
+    if (parsed.rest_threshold > 0) {
+        sim.set_rest_threshold(parsed.rest_threshold);
+    }
+    if (parsed.seed.has_value()) {
+        sim.set_seed(parsed.seed.value());
+    }
+    sim.set_checkpoint_handler([&](const auto& snapshot) {
+        if (snapshot.periodic) {
+            Fluid::CheckpointHeader header;
+            header.set_types(mapped.get_p_type(), mapped.get_v_type(),
+                             mapped.get_v_flow_type());
+            periodic.write(snapshot, header);
+            return;
+        }
+
+        std::string path = "save_" + std::to_string(snapshot.tick);
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open " + path + " for writing");
+        }
+
+        if (parsed.save_format == Parsed::Format::JSON) {
+            file << mapped.get_p_type() << " " << mapped.get_v_type() << " "
+                 << mapped.get_v_flow_type() << " " << mapped.get_rows() << " "
+                 << mapped.get_cols() << std::endl;
+            snapshot.serialize(file);
+        } else {
+            Fluid::CheckpointHeader header;
+            header.set_types(mapped.get_p_type(), mapped.get_v_type(),
+                             mapped.get_v_flow_type());
+            snapshot.serialize_binary(file, header);
+        }
+        if (!file.flush()) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+        std::cout << "Simulation saved to " + path + "\n" << std::flush;
+    });
+
+    if (!parsed.trajectory_path.empty()) {
+        Fluid::TrajectoryHeader header;
+        header.set_types(mapped.get_p_type(), mapped.get_v_type(),
+                         mapped.get_v_flow_type());
+        header.streams        = parsed.trajectory_streams;
+        header.keyframe_every = parsed.keyframe_every;
+        try {
+            sim.set_trajectory(parsed.trajectory_path, header);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    checkpoint_flag.store(&sim.checkpoint_request_flag());
+    std::signal(SIGINT, signal_handler);
+
+    std::ofstream frames_file;
+    if (!parsed.frames_out.empty()) {
+        frames_file.open(parsed.frames_out, std::ios::binary);
+        if (!frames_file.is_open()) {
+            std::cerr << "Cannot open " << parsed.frames_out << " for writing\n";
+            return 1;
+        }
+    }
+    sim.run(parsed.frames_out.empty() ? std::cout : frames_file);
+    std::signal(SIGINT, SIG_DFL);
+    checkpoint_flag.store(nullptr);
+
+    if (!parsed.frames_out.empty() && !frames_file.flush()) {
+        std::cerr << "Failed to write " << parsed.frames_out << '\n';
+        return 1;
+    }
+    if (sim.dropped_frames() > 0) {
+        std::cerr << "Dropped " << sim.dropped_frames()
+                  << " frames on a full frame ring\n";
+    }
+
+    if (parsed.rest_threshold > 0) {
+        auto&& skipped = sim.skip_history();
+        double total   = 0;
+        for (size_t i = 0; i < skipped.size(); ++i) {
+            std::cerr << "Tick " << i << ": skipped " << skipped[i] * 100
+                      << "% of tiles\n";
+            total += skipped[i];
+        }
+        std::cerr << "Skipped on average: "
+                  << (skipped.empty() ? 0 : total / skipped.size() * 100)
+                  << "% of tiles\n";
+    }
+
+    if (parsed.flow_stats) {
+        using ms = std::chrono::duration<double, std::milli>;
+        auto&& stats = sim.flow_stats();
+        for (size_t i = 0; i < stats.size(); ++i) {
+            std::cerr << "Worker " << i << ": busy " << ms(stats[i].busy).count()
+                      << " ms, idle " << ms(stats[i].idle).count() << " ms, "
+                      << stats[i].tiles << " tiles, " << stats[i].steals
+                      << " stolen\n";
+        }
+        std::cerr << "Flow sweeps: " << sim.flow_sweeps() << '\n';
+        auto [windowed, serial] = sim.seam_counts();
+        std::cerr << "Seam cells: " << windowed << " in parallel windows, "
+                  << serial << " left to the serial pass\n";
+    }
+
+    if constexpr (Fluid::profile_enabled) {
+        if (!parsed.profile_out.empty()) {
+            try {
+                sim.profile().write(parsed.profile_out);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << '\n';
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Runs the scenarios of the manifest. Returns the exit status.
+template <typename Sim>
+int run_scenarios(const Parsed& parsed, const Mapper& mapped) {
+    size_t workers = parsed.num_threads.value_or(
+        std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    auto batch = Fluid::run_batch<Sim>(parsed.manifest, mapped.get_rows(),
+                                       mapped.get_cols(), workers);
+
+    using ms   = std::chrono::duration<double, std::milli>;
+    int status = 0;
+    for (auto&& s : batch.scenarios) {
+        if (!s.error.empty()) {
+            std::cerr << "Scenario " << s.name << " failed: " << s.error << '\n';
+            status = 1;
+            continue;
+        }
+        std::cout << "Scenario " << s.name << ": " << s.ticks << " ticks, "
+                  << ms(s.time).count() << " ms\n";
+    }
+    std::cout << "Batch: " << batch.scenarios.size() << " scenarios, "
+              << batch.ticks() << " ticks in " << ms(batch.time).count() << " ms, "
+              << batch.ticks_per_second() << " ticks/s\n";
+    return status;
+}
+
+// Everything main does with one FluidSim specialization. Instance builds
+// compile it once per translation unit (cmake/Instances.cmake).
+template <typename Sim>
+int run_instance(const Parsed& parsed, const Mapper& mapped) {
+    if (parsed.type == Parsed::Type::BATCH) {
+        return run_scenarios<Sim>(parsed, mapped);
+    }
+    return run_simulation<Sim>(parsed, mapped);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Fluid {
+
+// Append-only buffer of fixed-size blocks for a single writer. Growing adds
+// a block and never moves stored elements, and clear() keeps the blocks, so
+// a buffer settles at its high-water mark and stops allocating.
+template <typename T, size_t BLOCK = 1024>
+class SegmentedBuffer {
+    static_assert((BLOCK & (BLOCK - 1)) == 0, "BLOCK must be a power of two");
+
+  public:
+    template <typename... Args>
+    void emplace_back(Args&&... args) {
+        size_t block = count / BLOCK;
+        if (block == blocks.size()) {
+            blocks.push_back(std::make_unique<T[]>(BLOCK));
+        }
+        blocks[block][count % BLOCK] = T(std::forward<Args>(args)...);
+        ++count;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t capacity() const {
+        return blocks.size() * BLOCK;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    template <typename F>
+    void for_each(F&& func) const {
+        for (size_t i = 0; i < count; ++i) {
+            func(blocks[i / BLOCK][i % BLOCK]);
+        }
+    }
+
+    template <typename Container>
+    void append_to(Container& out) const {
+        for (size_t i = 0; i < count; i += BLOCK) {
+            const T* block = blocks[i / BLOCK].get();
+            out.insert(out.end(), block, block + std::min(BLOCK, count - i));
+        }
+    }
+
+  private:
+    std::vector<std::unique_ptr<T[]>> blocks;
+    size_t count = 0;
+};
+
+} // namespace Fluid
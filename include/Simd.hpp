@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace Fluid {
+
+// Lane type the vector kernels operate on. `shift` is the number of
+// fractional bits for fixed-point lanes and 0 for floating point.
+template <typename T>
+struct SimdLane {
+    using type                      = void;
+    static constexpr unsigned shift = 0;
+};
+
+template <>
+struct SimdLane<float> {
+    using type                      = float;
+    static constexpr unsigned shift = 0;
+};
+
+template <>
+struct SimdLane<double> {
+    using type                      = double;
+    static constexpr unsigned shift = 0;
+};
+
+namespace simd {
+
+enum class Isa {
+    SCALAR,
+    SSE4,
+    AVX2
+};
+
+// Direction planes in storage order, the same order FluidSim::dir_index
+// produces.
+inline constexpr std::array<std::pair<int, int>, 4> dir_offsets{
+    { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } }
+};
+
+// Bits of the per-cell open mask: bit d is set when the neighbour in
+// direction d is not a wall, OPEN_SELF when the cell itself is not a wall.
+inline constexpr uint8_t OPEN_SELF = 1 << 4;
+
+constexpr uint8_t open_bit(size_t d) {
+    return static_cast<uint8_t>(1 << d);
+}
+
+// Multiplier type for constants the scalar code applies in double
+// precision, such as the 0.8 damping of water.
+template <typename R>
+using Factor = std::conditional_t<std::is_floating_point_v<R>, double, R>;
+
+// Row-major views of the simulation arrays. Strides are in elements.
+template <typename R>
+struct Cells {
+    std::array<R*, 4> velocity{};
+    std::array<const R*, 4> velocity_flow{};
+    R* p                = nullptr;
+    const int* dirs     = nullptr;
+    const char* field   = nullptr;
+    const uint8_t* open = nullptr;
+
+    size_t velocity_stride = 0;
+    size_t flow_stride     = 0;
+    size_t p_stride        = 0;
+    size_t dirs_stride     = 0;
+    size_t field_stride    = 0;
+    size_t open_stride     = 0;
+
+    R g{};
+    R rho_air{};
+    R rho_water{};
+    Factor<R> water_factor{};
+    unsigned shift = 0;
+};
+
+// Half-open block of cells [x0, x1) x [y0, y1).
+struct Region {
+    size_t x0, x1, y0, y1;
+};
+
+#define FLUID_SIMD_DECLARE_KERNELS(ns)                                            \
+    namespace ns {                                                                \
+    template <typename R>                                                         \
+    void apply_external_forces(const Cells<R>& cells, Region region);             \
+    template <typename R>                                                         \
+    void recalc_p(const Cells<R>& cells, Region region);                          \
+    }
+
+FLUID_SIMD_DECLARE_KERNELS(scalar)
+#ifdef FLUID_SIMD_X86
+FLUID_SIMD_DECLARE_KERNELS(sse4)
+FLUID_SIMD_DECLARE_KERNELS(avx2)
+#endif
+
+#undef FLUID_SIMD_DECLARE_KERNELS
+
+inline Isa best_isa() {
+#ifdef FLUID_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return Isa::SSE4;
+    }
+#endif
+    return Isa::SCALAR;
+}
+
+inline Isa& active_isa() {
+    static Isa isa = best_isa();
+    return isa;
+}
+
+inline Isa parse_isa(const std::string& name) {
+    if (name == "auto") {
+        return best_isa();
+    }
+    if (name == "scalar") {
+        return Isa::SCALAR;
+    }
+    if (name == "sse4") {
+        return Isa::SSE4;
+    }
+    if (name == "avx2") {
+        return Isa::AVX2;
+    }
+    throw std::runtime_error("Error: Unknown instruction set: " + name);
+}
+
+inline void set_isa(Isa isa) {
+    if (isa > best_isa()) {
+        throw std::runtime_error("Error: Instruction set is not supported here");
+    }
+    active_isa() = isa;
+}
+
+template <typename R>
+void apply_external_forces(const Cells<R>& cells, Region region) {
+    switch (active_isa()) {
+#ifdef FLUID_SIMD_X86
+    case Isa::AVX2:
+        return avx2::apply_external_forces(cells, region);
+    case Isa::SSE4:
+        return sse4::apply_external_forces(cells, region);
+#endif
+    default:
+        return scalar::apply_external_forces(cells, region);
+    }
+}
+
+template <typename R>
+void recalc_p(const Cells<R>& cells, Region region) {
+    switch (active_isa()) {
+#ifdef FLUID_SIMD_X86
+    case Isa::AVX2:
+        return avx2::recalc_p(cells, region);
+    case Isa::SSE4:
+        return sse4::recalc_p(cells, region);
+#endif
+    default:
+        return scalar::recalc_p(cells, region);
+    }
+}
+
+} // namespace simd
+} // namespace Fluid
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace Fluid {
+
+// Per-worker deques of tile indices. A worker takes its own tiles from the
+// back and, once it runs out, steals from the front of the other deques.
+class TileScheduler {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct WorkerStats {
+        Clock::duration busy{};
+        Clock::duration idle{};
+        size_t tiles  = 0;
+        size_t steals = 0;
+    };
+
+    explicit TileScheduler(size_t workers)
+        : queues(workers),
+          planned(workers),
+          stats(workers),
+          phase_busy(workers) {
+    }
+
+    // Longest processing time first: tiles go, heaviest first, to the worker
+    // with the least cost planned so far. Costs change once per tick, so the
+    // plan is made once and every sweep only refills the deques from it.
+    void plan(std::span<const uint64_t> cost) {
+        order.resize(cost.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return cost[a] > cost[b];
+        });
+
+        load.assign(queues.size(), 0);
+        for (auto&& tiles : planned) {
+            tiles.clear();
+        }
+        for (size_t tile : order) {
+            size_t w = std::min_element(load.begin(), load.end()) - load.begin();
+            load[w] += cost[tile];
+            planned[w].push_back(tile);
+        }
+    }
+
+    void refill() {
+        for (size_t w = 0; w < queues.size(); ++w) {
+            queues[w].tiles.assign(planned[w].begin(), planned[w].end());
+        }
+    }
+
+    // Called by every worker; returns when no tile is left anywhere.
+    template <typename F>
+    void run(size_t worker, F&& func) {
+        auto start = Clock::now();
+        size_t tile;
+        while (pop(worker, tile) || steal(worker, tile)) {
+            func(tile);
+            ++stats[worker].tiles;
+        }
+        phase_busy[worker] = Clock::now() - start;
+        stats[worker].busy += phase_busy[worker];
+    }
+
+    // Charges every worker the part of the phase it spent waiting.
+    void finish_phase(Clock::duration wall) {
+        for (size_t w = 0; w < stats.size(); ++w) {
+            stats[w].idle += std::max(wall - phase_busy[w], Clock::duration{});
+        }
+    }
+
+    const std::vector<WorkerStats>& worker_stats() const {
+        return stats;
+    }
+
+  private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<size_t> tiles;
+    };
+
+    bool pop(size_t worker, size_t& tile) {
+        auto& q = queues[worker];
+        std::lock_guard lock{ q.mutex };
+        if (q.tiles.empty()) {
+            return false;
+        }
+        tile = q.tiles.back();
+        q.tiles.pop_back();
+        return true;
+    }
+
+    bool steal(size_t worker, size_t& tile) {
+        for (size_t i = 1; i < queues.size(); ++i) {
+            auto& q = queues[(worker + i) % queues.size()];
+            std::lock_guard lock{ q.mutex };
+            if (!q.tiles.empty()) {
+                tile = q.tiles.front();
+                q.tiles.pop_front();
+                ++stats[worker].steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues;
+    std::vector<std::vector<size_t>> planned;
+    std::vector<WorkerStats> stats;
+    std::vector<Clock::duration> phase_busy;
+    std::vector<size_t> order;
+    std::vector<uint64_t> load;
+};
+
+} // namespace Fluid
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace Fluid {
+
+// Per-cell arrays a trajectory can hold; the field is always there.
+enum TrajectoryStream : uint32_t {
+    TRAJECTORY_FIELD    = 1,
+    TRAJECTORY_P        = 2,
+    TRAJECTORY_VELOCITY = 4
+};
+
+// A trajectory is this header followed by one record per tick. A record
+// holds, for every stream of the header in the order above, a run count
+// and the runs of cells that changed since the previous record: start cell,
+// cell count and the raw cells. A keyframe is a single run over all cells,
+// so decoding can start at any keyframe.
+struct TrajectoryHeader {
+    static constexpr std::array<char, 8> MAGIC{ 'F', 'L', 'U', 'I',
+                                                'D', 'T', 'R', 'J' };
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t NAME_SIZE = 32;
+
+    std::array<char, 8> magic = MAGIC;
+    uint32_t version          = VERSION;
+    uint32_t streams          = TRAJECTORY_FIELD;
+    std::array<char, NAME_SIZE> p_type{};
+    std::array<char, NAME_SIZE> v_type{};
+    std::array<char, NAME_SIZE> v_flow_type{};
+    uint64_t rows           = 0;
+    uint64_t cols           = 0;
+    uint32_t p_size         = 0;
+    uint32_t velocity_size  = 0;
+    uint64_t keyframe_every = 64;
+
+    void set_types(std::string_view p, std::string_view v, std::string_view v_flow) {
+        copy_name(p_type, p);
+        copy_name(v_type, v);
+        copy_name(v_flow_type, v_flow);
+    }
+
+    // Bytes per cell of each stream, in record order.
+    std::vector<size_t> cell_sizes() const {
+        std::vector<size_t> sizes{ 1 };
+        if (streams & TRAJECTORY_P) {
+            sizes.push_back(p_size);
+        }
+        if (streams & TRAJECTORY_VELOCITY) {
+            sizes.push_back(velocity_size);
+        }
+        return sizes;
+    }
+
+  private:
+    static void copy_name(std::array<char, NAME_SIZE>& dst, std::string_view src) {
+        if (src.size() >= NAME_SIZE) {
+            throw std::runtime_error("Type name is too long for a trajectory: " +
+                                     std::string(src));
+        }
+        dst.fill('\0');
+        std::memcpy(dst.data(), src.data(), src.size());
+    }
+};
+
+struct TrajectoryRecord {
+    uint64_t tick     = 0;
+    uint32_t keyframe = 0;
+    uint32_t reserved = 0;
+    uint64_t bytes    = 0;
+};
+
+struct TrajectoryRun {
+    uint32_t start;
+    uint32_t count;
+};
+
+static_assert(std::is_trivially_copyable_v<TrajectoryHeader>);
+
+// Appends one record per recorded tick, each with a single write. Streams
+// are compared cell by cell with the previous record, so the field record
+// holds exactly the cells the tick's moves changed.
+class TrajectoryWriter {
+  public:
+    TrajectoryWriter(const std::string& path, const TrajectoryHeader& header)
+        : path(path),
+          hdr(header),
+          file(path, std::ios::binary) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open " + path + " for writing");
+        }
+        if (hdr.rows * hdr.cols > UINT32_MAX) {
+            throw std::runtime_error("Field is too large for a trajectory");
+        }
+        hdr.keyframe_every = std::max<uint64_t>(hdr.keyframe_every, 1);
+        previous.resize(hdr.cell_sizes().size());
+        file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        check();
+    }
+
+    const TrajectoryHeader& header() const {
+        return hdr;
+    }
+
+    // `cells` holds one span per stream of the header, rows * cols cells
+    // each.
+    void record(size_t tick, std::span<const std::span<const std::byte>> cells) {
+        auto sizes = hdr.cell_sizes();
+        bool key   = recorded % hdr.keyframe_every == 0;
+        buffer.resize(sizeof(TrajectoryRecord));
+        for (size_t s = 0; s < sizes.size(); ++s) {
+            append_runs(cells[s], previous[s], sizes[s], key);
+        }
+
+        TrajectoryRecord record;
+        record.tick     = tick;
+        record.keyframe = key;
+        record.bytes    = buffer.size() - sizeof(record);
+        std::memcpy(buffer.data(), &record, sizeof(record));
+        file.write(buffer.data(), buffer.size());
+        check();
+        ++recorded;
+    }
+
+    void flush() {
+        file.flush();
+        check();
+    }
+
+  private:
+    void append_runs(std::span<const std::byte> now, std::vector<std::byte>& before,
+                     size_t size, bool key) {
+        size_t cells   = now.size() / size;
+        size_t at      = buffer.size();
+        uint64_t count = 0;
+        buffer.resize(at + sizeof(count));
+        if (key || before.size() != now.size()) {
+            append_run(now, 0, cells, size);
+            count = 1;
+            before.assign(now.begin(), now.end());
+        } else {
+            for (size_t i = 0; i < cells;) {
+                if (std::memcmp(&now[i * size], &before[i * size], size) == 0) {
+                    ++i;
+                    continue;
+                }
+                size_t start = i;
+                while (i < cells &&
+                       std::memcmp(&now[i * size], &before[i * size], size) != 0) {
+                    ++i;
+                }
+                std::memcpy(&before[start * size], &now[start * size],
+                            (i - start) * size);
+                append_run(now, start, i - start, size);
+                ++count;
+            }
+        }
+        std::memcpy(buffer.data() + at, &count, sizeof(count));
+    }
+
+    void append_run(std::span<const std::byte> now, size_t start, size_t count,
+                    size_t size) {
+        TrajectoryRun run{ static_cast<uint32_t>(start),
+                           static_cast<uint32_t>(count) };
+        size_t at = buffer.size();
+        buffer.resize(at + sizeof(run) + count * size);
+        std::memcpy(buffer.data() + at, &run, sizeof(run));
+        std::memcpy(buffer.data() + at + sizeof(run), &now[start * size],
+                    count * size);
+    }
+
+    void check() {
+        if (!file) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+
+    std::string path;
+    TrajectoryHeader hdr;
+    std::ofstream file;
+    size_t recorded = 0;
+    std::vector<char> buffer;
+    std::vector<std::vector<std::byte>> previous;
+};
+
+// Maps a trajectory and finds its records. A file cut short by a crash
+// reads up to its last complete record.
+class TrajectoryReader {
+  public:
+    struct Entry {
+        uint64_t tick;
+        bool keyframe;
+        const char* data;
+        uint64_t bytes;
+    };
+
+    // The cells of every stream at one tick.
+    struct State {
+        size_t tick = 0;
+        std::vector<std::vector<std::byte>> cells;
+    };
+
+    explicit TrajectoryReader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open trajectory: " + path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 ||
+            static_cast<size_t>(st.st_size) < sizeof(TrajectoryHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Trajectory is truncated: " + path);
+        }
+        size      = st.st_size;
+        void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Cannot mmap trajectory: " + path);
+        }
+        data = static_cast<const char*>(ptr);
+        std::memcpy(&hdr, data, sizeof(hdr));
+        if (hdr.magic != TrajectoryHeader::MAGIC ||
+            hdr.version != TrajectoryHeader::VERSION) {
+            unmap();
+            throw std::runtime_error("Not a supported trajectory: " + path);
+        }
+
+        for (size_t at = sizeof(hdr); at + sizeof(TrajectoryRecord) <= size;) {
+            TrajectoryRecord record;
+            std::memcpy(&record, data + at, sizeof(record));
+            at += sizeof(record);
+            if (record.bytes > size - at) {
+                break;
+            }
+            records.push_back({ record.tick, record.keyframe != 0, data + at,
+                                record.bytes });
+            at += record.bytes;
+        }
+    }
+
+    TrajectoryReader(const TrajectoryReader&)            = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    ~TrajectoryReader() {
+        unmap();
+    }
+
+    const TrajectoryHeader& header() const {
+        return hdr;
+    }
+
+    const std::vector<Entry>& entries() const {
+        return records;
+    }
+
+    // Index of the record of `tick`.
+    size_t find(size_t tick) const {
+        auto it = std::ranges::find_if(records, [&](const Entry& e) {
+            return e.tick == tick;
+        });
+        if (it == records.end()) {
+            throw std::runtime_error("Tick " + std::to_string(tick) +
+                                     " is not in the trajectory");
+        }
+        return it - records.begin();
+    }
+
+    // Decodes from the last keyframe at or before `tick`.
+    State seek(size_t tick) const {
+        size_t last = find(tick);
+        size_t key  = last;
+        while (!records[key].keyframe) {
+            if (key == 0) {
+                throw std::runtime_error("Trajectory has no keyframe before tick " +
+                                         std::to_string(tick));
+            }
+            --key;
+        }
+
+        State state;
+        state.cells.resize(hdr.cell_sizes().size());
+        for (size_t i = key; i <= last; ++i) {
+            apply(state, i);
+        }
+        return state;
+    }
+
+    // Applies record i, which must follow the state's record.
+    void apply(State& state, size_t i) const {
+        auto& e    = records.at(i);
+        auto sizes = hdr.cell_sizes();
+        size_t n   = hdr.rows * hdr.cols;
+        const char* at  = e.data;
+        const char* end = e.data + e.bytes;
+        for (size_t s = 0; s < sizes.size(); ++s) {
+            state.cells[s].resize(n * sizes[s]);
+            uint64_t count;
+            read(at, end, &count, sizeof(count));
+            for (uint64_t r = 0; r < count; ++r) {
+                TrajectoryRun run;
+                read(at, end, &run, sizeof(run));
+                if (uint64_t{ run.start } + run.count > n) {
+                    throw std::runtime_error("Trajectory run out of bounds");
+                }
+                read(at, end, state.cells[s].data() + run.start * sizes[s],
+                     run.count * sizes[s]);
+            }
+        }
+        state.tick = e.tick;
+    }
+
+  private:
+    static void read(const char*& at, const char* end, void* dst, size_t bytes) {
+        if (static_cast<size_t>(end - at) < bytes) {
+            throw std::runtime_error("Trajectory record is truncated");
+        }
+        std::memcpy(dst, at, bytes);
+        at += bytes;
+    }
+
+    void unmap() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+            data = nullptr;
+        }
+    }
+
+    TrajectoryHeader hdr{};
+    const char* data = nullptr;
+    size_t size      = 0;
+    std::vector<Entry> records;
+};
+
+} // namespace Fluid
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Simd.hpp"
 #include "nlohmann/json.hpp"
 #include <concepts>
 #include <cstdint>
@@ -195,6 +196,75 @@ T operator/(T x, const Fixed<N, K, F>& y) {
     return x /= y;
 }
 
+// A divisor prepared for dividing many values of T by it: a / Reciprocal(d)
+// equals a / d. Floating point types simply divide.
+template <typename T>
+struct Reciprocal {
+    constexpr Reciprocal() = default;
+
+    constexpr explicit Reciprocal(T d)
+        : d(d) {
+    }
+
+    friend T operator/(T a, const Reciprocal& r) {
+        return a / r.d;
+    }
+
+    T d{};
+};
+
+// For N <= 32 the shifted dividend fits a double exactly, so the quotient is
+// estimated by a multiply by 1/d, at most two off, and fixed by the
+// remainder: the result matches Fixed::operator/ bit for bit without an
+// integer division. Dividends past 2^53 take the plain division.
+template <unsigned N, unsigned K, bool F>
+    requires(N <= 32)
+struct Reciprocal<Fixed<N, K, F>> {
+    using T = Fixed<N, K, F>;
+
+    constexpr Reciprocal() = default;
+
+    constexpr explicit Reciprocal(T d)
+        : d(d.v < 0 ? -int64_t{ d.v } : d.v),
+          negative(d.v < 0),
+          inv(d.v == 0 ? 0 : 1.0 / this->d) {
+    }
+
+    friend T operator/(T a, const Reciprocal& r) {
+        if (r.d == 0) {
+            throw std::runtime_error("Division by zero in Fixed-point arithmetic");
+        }
+        int64_t n  = static_cast<int64_t>(a.v) << K;
+        uint64_t m = n < 0 ? -static_cast<uint64_t>(n) : n;
+        if (m >= (uint64_t{ 1 } << 53)) {
+            int64_t q = n / r.d;
+            return T::from_raw(r.negative ? -q : q);
+        }
+        int64_t q   = static_cast<int64_t>(m * r.inv);
+        int64_t rem = static_cast<int64_t>(m) - q * r.d;
+        while (rem < 0) {
+            --q;
+            rem += r.d;
+        }
+        while (rem >= r.d) {
+            ++q;
+            rem -= r.d;
+        }
+        return T::from_raw((n < 0) != r.negative ? -q : q);
+    }
+
+    int64_t d     = 0;
+    bool negative = false;
+    double inv    = 0;
+};
+
+template <unsigned K, bool F>
+    requires std::is_same_v<typename Fixed<32, K, F>::type, int32_t>
+struct SimdLane<Fixed<32, K, F>> {
+    using type                      = int32_t;
+    static constexpr unsigned shift = K;
+};
+
 template<unsigned N, unsigned K, bool F>
 void to_json(nlohmann::json& j, const Fixed<N, K, F>& a) {
     j = a.v;
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Fluid {
+
+// Worker threads shared by every simulation in the process. run(n, job) calls
+// job(i) for i in [0, n): job(0) runs on the calling thread, the rest on pool
+// threads, which are started on demand and kept for later phases. Phases of
+// different callers are serialized; a simulation's phase already occupies all
+// of its workers, so interleaving them would only add contention.
+class WorkerPool {
+  public:
+    WorkerPool() = default;
+
+    WorkerPool(const WorkerPool&)            = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Stops and joins the threads; they only ever wait between phases, so
+    // the stop request wakes them right away.
+    ~WorkerPool() {
+        for (auto&& t : threads) {
+            t.request_stop();
+        }
+        threads.clear();
+    }
+
+    static WorkerPool& shared() {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    // Starts the threads for phases of n workers ahead of the first phase.
+    void reserve(size_t n) {
+        std::lock_guard submit{ submit_mutex };
+        std::lock_guard lock{ mutex };
+        grow(n);
+    }
+
+    // Pins worker i to cpus[i % cpus.size()], the calling thread taking the
+    // place of worker 0. An empty list leaves placement to the scheduler.
+    void pin(std::vector<unsigned> list) {
+        std::lock_guard submit{ submit_mutex };
+        std::lock_guard lock{ mutex };
+        cpus = std::move(list);
+        pin_thread(0);
+        ++pinning;
+    }
+
+    void run(size_t n, const std::function<void(size_t)>& job) {
+        std::lock_guard submit{ submit_mutex };
+        {
+            std::lock_guard lock{ mutex };
+            grow(n);
+            current   = &job;
+            active    = n;
+            remaining = n - 1;
+            ++generation;
+        }
+        wake.notify_all();
+        job(0);
+        std::unique_lock lock{ mutex };
+        done.wait(lock, [&] { return remaining == 0; });
+        current = nullptr;
+    }
+
+    size_t size() const {
+        std::lock_guard lock{ mutex };
+        return threads.size() + 1;
+    }
+
+    // Parses the --pin-threads value: "none", "compact" (the CPUs this
+    // process may run on, in order) or a list such as "0,2,4-7".
+    static std::vector<unsigned> parse_cpus(const std::string& spec) {
+        std::vector<unsigned> list;
+        if (spec.empty() || spec == "none") {
+            return list;
+        }
+        if (spec == "compact") {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        list.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            if (list.empty()) {
+                for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency();
+                     ++cpu) {
+                    list.push_back(cpu);
+                }
+            }
+            return list;
+        }
+
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t end = spec.find(',', pos);
+            if (end == std::string::npos) {
+                end = spec.size();
+            }
+            auto item   = spec.substr(pos, end - pos);
+            size_t dash = item.find('-');
+            size_t len  = 0;
+            try {
+                unsigned first = std::stoul(item.substr(0, dash), &len);
+                unsigned last  = first;
+                if (len != std::min(dash, item.size())) {
+                    throw std::invalid_argument{ item };
+                }
+                if (dash != std::string::npos) {
+                    auto tail = item.substr(dash + 1);
+                    last      = std::stoul(tail, &len);
+                    if (len != tail.size() || last < first) {
+                        throw std::invalid_argument{ item };
+                    }
+                }
+                for (unsigned cpu = first; cpu <= last; ++cpu) {
+                    list.push_back(cpu);
+                }
+            } catch (const std::logic_error&) {
+                throw std::runtime_error("Error: Bad CPU list in --pin-threads: " +
+                                         spec);
+            }
+            pos = end + 1;
+        }
+        return list;
+    }
+
+  private:
+    // Needs both locks held.
+    void grow(size_t n) {
+        while (threads.size() + 1 < n) {
+            size_t index = threads.size() + 1;
+            threads.emplace_back(
+                [this, index, seen = generation](std::stop_token stop) {
+                    work(stop, index, seen);
+                });
+        }
+    }
+
+    void work(std::stop_token stop, size_t index, uint64_t seen) {
+        uint64_t pinned = 0;
+        std::unique_lock lock{ mutex };
+        while (true) {
+            if (!wake.wait(lock, stop, [&] { return generation != seen; })) {
+                return;
+            }
+            seen = generation;
+            if (pinned != pinning) {
+                pinned = pinning;
+                pin_thread(index);
+            }
+            if (index >= active) {
+                continue;
+            }
+            auto* job = current;
+            lock.unlock();
+            (*job)(index);
+            lock.lock();
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    // Called on the thread being pinned.
+    void pin_thread(size_t index) const {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (cpus.empty()) {
+            unsigned count = std::thread::hardware_concurrency();
+            for (unsigned cpu = 0; cpu < count; ++cpu) {
+                CPU_SET(cpu, &set);
+            }
+        } else {
+            CPU_SET(cpus[index % cpus.size()], &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)index;
+#endif
+    }
+
+    std::mutex submit_mutex;
+    mutable std::mutex mutex;
+    std::condition_variable_any wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* current = nullptr;
+    size_t active       = 0;
+    size_t remaining    = 0;
+    uint64_t generation = 0;
+    uint64_t pinning    = 0;
+    std::vector<unsigned> cpus;
+    std::vector<std::jthread> threads;
+};
+
+} // namespace Fluid
@@ -1,23 +1,14 @@
-#include "include/FluidSim.hpp"
-#include "include/Mapping.hpp"
+#include "include/Run.hpp"
 #include <cxxopts.hpp>
 #include <iostream>
 #include <string>
 #include <optional>
+#include <sstream>
+#include <vector>
 
-struct Parsed {
-    enum class Type {
-        READ_FIELD,
-        LOAD_SAVE
-    };
-    Type type;
-    std::string p_type;
-    std::string v_type;
-    std::string v_flow_type;
-    std::string field_path;
-    std::string load_path;
-    std::optional<size_t> num_threads;
-};
+#ifdef FLUID_INSTANCE_TABLE
+#include "FluidInstances.hpp"
+#endif
 
 Parsed parse_arguments(int argc, char* argv[]) {
     try {
@@ -32,8 +23,65 @@ Parsed parse_arguments(int argc, char* argv[]) {
             cxxopts::value<std::string>())("field-path", "Path to the field",
                                            cxxopts::value<std::string>())(
             "load-path", "Path to the saved simulation",
+            cxxopts::value<std::string>())(
+            "batch",
+            "Run the scenarios of a JSON manifest, --num-threads at a time "
+            "(default: all cores)",
             cxxopts::value<std::string>())("num-threads", "Number of threads",
-                                           cxxopts::value<size_t>());
+                                           cxxopts::value<size_t>())(
+            "save-format", "Checkpoint format on CTRL-C: binary or json",
+            cxxopts::value<std::string>()->default_value("binary"))(
+            "checkpoint-every",
+            "Write a base checkpoint and then sparse deltas every N ticks",
+            cxxopts::value<size_t>()->default_value("0"))(
+            "simd",
+            "Kernel instruction set: auto, avx2, sse4 or scalar (SoA builds only)",
+            cxxopts::value<std::string>()->default_value("auto"))(
+            "rng-mode",
+            "Movement randomness: mt19937 (serial scan) or counter (parallel)",
+            cxxopts::value<std::string>()->default_value("mt19937"))(
+            "seed", "Seed of the movement randomness (default 1337)",
+            cxxopts::value<uint64_t>())(
+            "ticks", "Tick to stop at (default 100)", cxxopts::value<size_t>())(
+            "output",
+            "Frames to print: none, ascii (every tick with a move) or every-N "
+            "(only ticks divisible by N)",
+            cxxopts::value<std::string>()->default_value("ascii"))(
+            "frame-format",
+            "Frame encoding: ascii or delta (changed cells since the last frame)",
+            cxxopts::value<std::string>()->default_value("ascii"))(
+            "frame-ring",
+            "Frames queued for the writer thread (0 = write in the simulation "
+            "thread)",
+            cxxopts::value<size_t>()->default_value("4"))(
+            "frame-policy", "On a full frame ring: block or drop",
+            cxxopts::value<std::string>()->default_value("block"))(
+            "frames-out", "Write frames and the run time to a file, not stdout",
+            cxxopts::value<std::string>())(
+            "trajectory",
+            "Record the field after every tick to a binary trajectory file "
+            "(fluid_replay reads it)",
+            cxxopts::value<std::string>())(
+            "trajectory-with", "Also record p, velocity or both: p,velocity",
+            cxxopts::value<std::string>()->default_value(""))(
+            "keyframe-every", "Ticks between full frames of the trajectory",
+            cxxopts::value<size_t>()->default_value("64"))(
+            "flow-solver",
+            "Flow augmentation: unit (reference) or saturating (whole bottleneck)",
+            cxxopts::value<std::string>()->default_value("unit"))(
+            "rest-threshold",
+            "Skip tiles whose pressure and velocity changes stayed below this "
+            "value (0 = off); prints the skipped share per tick",
+            cxxopts::value<double>()->default_value("0"))(
+            "flow-stats", "Print per-worker busy and idle time of the flow phase")(
+            "profile-out",
+            "Write per-tick phase times and counters to a CSV file, or JSON for "
+            "a .json path (builds with -DFLUID_PROFILE=ON)",
+            cxxopts::value<std::string>())(
+            "pin-threads",
+            "Pin worker i to the i-th CPU: compact (allowed CPUs in order) or a "
+            "list such as 0,2,4-7",
+            cxxopts::value<std::string>());
 
         auto result = options.parse(argc, argv);
 
@@ -42,15 +90,18 @@ Parsed parse_arguments(int argc, char* argv[]) {
             std::exit(0);
         }
 
-        if (!(result.count("load-path") ^
-              (result.count("p-type") && result.count("v-type") &&
-               result.count("v-flow-type") && result.count("field-path")))) {
+        bool field_given = result.count("p-type") && result.count("v-type") &&
+                           result.count("v-flow-type") && result.count("field-path");
+        if (result.count("load-path") + result.count("batch") + field_given != 1) {
             throw std::runtime_error(
-                "Error: Either load-path or all parameters (--p-type, "
+                "Error: Either load-path, batch or all parameters (--p-type, "
                 "--v-type, --v-flow-type, --field-path) must be provided.");
         }
 
-        if (result.count("load-path")) {
+        if (result.count("batch")) {
+            parsed.type       = Parsed::Type::BATCH;
+            parsed.batch_path = result["batch"].as<std::string>();
+        } else if (result.count("load-path")) {
             parsed.type      = Parsed::Type::LOAD_SAVE;
             parsed.load_path = result["load-path"].as<std::string>();
         } else {
@@ -63,6 +114,103 @@ Parsed parse_arguments(int argc, char* argv[]) {
         if (result.count("num-threads")) {
             parsed.num_threads = result["num-threads"].as<size_t>();
         }
+        if (result.count("seed")) {
+            if (parsed.type == Parsed::Type::LOAD_SAVE) {
+                throw std::runtime_error(
+                    "Error: --seed cannot be used with --load-path, the "
+                    "checkpoint keeps its seed");
+            }
+            parsed.seed = result["seed"].as<uint64_t>();
+        }
+
+        if (result.count("ticks")) {
+            parsed.ticks = result["ticks"].as<size_t>();
+        }
+        parsed.output =
+            Fluid::parse_frame_output(result["output"].as<std::string>());
+        parsed.output.format =
+            Fluid::parse_frame_format(result["frame-format"].as<std::string>());
+        parsed.output.ring = result["frame-ring"].as<size_t>();
+        auto frame_policy  = result["frame-policy"].as<std::string>();
+        if (frame_policy != "block" && frame_policy != "drop") {
+            throw std::runtime_error("Error: Unknown frame policy: " + frame_policy);
+        }
+        parsed.output.drop_when_full = frame_policy == "drop";
+        if (result.count("trajectory")) {
+            if (parsed.type == Parsed::Type::BATCH) {
+                throw std::runtime_error(
+                    "Error: --trajectory cannot be used with --batch");
+            }
+            parsed.trajectory_path = result["trajectory"].as<std::string>();
+        }
+        std::stringstream streams{ result["trajectory-with"].as<std::string>() };
+        for (std::string name; std::getline(streams, name, ',');) {
+            if (name == "p") {
+                parsed.trajectory_streams |= Fluid::TRAJECTORY_P;
+            } else if (name == "velocity") {
+                parsed.trajectory_streams |= Fluid::TRAJECTORY_VELOCITY;
+            } else {
+                throw std::runtime_error("Error: Unknown trajectory stream: " +
+                                         name);
+            }
+        }
+        parsed.keyframe_every = result["keyframe-every"].as<size_t>();
+        if (parsed.keyframe_every == 0) {
+            throw std::runtime_error("Error: --keyframe-every must be positive");
+        }
+
+        if (result.count("frames-out")) {
+            if (parsed.type == Parsed::Type::BATCH) {
+                throw std::runtime_error(
+                    "Error: --frames-out cannot be used with --batch");
+            }
+            parsed.frames_out = result["frames-out"].as<std::string>();
+        }
+
+        if (result.count("pin-threads")) {
+            parsed.pin_cpus = Fluid::WorkerPool::parse_cpus(
+                result["pin-threads"].as<std::string>());
+        }
+
+        parsed.checkpoint_every = result["checkpoint-every"].as<size_t>();
+        parsed.flow_stats       = result.count("flow-stats") > 0;
+        if (result.count("profile-out")) {
+            if (!Fluid::profile_enabled) {
+                throw std::runtime_error(
+                    "Error: --profile-out needs a build with -DFLUID_PROFILE=ON");
+            }
+            if (parsed.type == Parsed::Type::BATCH) {
+                throw std::runtime_error(
+                    "Error: --profile-out cannot be used with --batch");
+            }
+            parsed.profile_out = result["profile-out"].as<std::string>();
+        }
+        parsed.rest_threshold   = result["rest-threshold"].as<double>();
+        if (parsed.rest_threshold < 0) {
+            throw std::runtime_error("Error: --rest-threshold must not be negative");
+        }
+
+        auto save_format = result["save-format"].as<std::string>();
+        if (save_format == "binary") {
+            parsed.save_format = Parsed::Format::BINARY;
+        } else if (save_format == "json") {
+            parsed.save_format = Parsed::Format::JSON;
+        } else {
+            throw std::runtime_error("Error: Unknown save format: " + save_format);
+        }
+
+        parsed.rng_mode =
+            Fluid::parse_rng_mode(result["rng-mode"].as<std::string>());
+        parsed.flow_solver =
+            Fluid::parse_flow_solver(result["flow-solver"].as<std::string>());
+
+        auto simd = result["simd"].as<std::string>();
+        if (!Fluid::DefaultLayout::planar && simd != "auto") {
+            throw std::runtime_error(
+                "Error: --simd needs a build with -DFLUID_SOA_LAYOUT=ON");
+        }
+        parsed.simd = Fluid::simd::parse_isa(simd);
+        Fluid::simd::set_isa(parsed.simd);
 
         return parsed;
 
@@ -75,54 +223,72 @@ Parsed parse_arguments(int argc, char* argv[]) {
     }
 }
 
-static std::function<void(int)> shutdown_handler;
-static void signal_handler(int signal) {
-    shutdown_handler(signal);
+// Runs the FluidSim specialization the types and size select.
+int dispatch(const Parsed& parsed, Mapper& mapped) {
+#ifdef FLUID_INSTANCE_TABLE
+    auto size   = "S(" + std::to_string(mapped.get_rows()) + "," +
+                  std::to_string(mapped.get_cols()) + ")";
+    auto* entry = Fluid::find_instance(
+        instance_table, Fluid::instance_key(mapped.get_p_type(), mapped.get_v_type(),
+                                            mapped.get_v_flow_type(), size));
+    if (entry == nullptr) {
+        entry = Fluid::find_instance(
+            instance_table,
+            Fluid::instance_key(mapped.get_p_type(), mapped.get_v_type(),
+                                mapped.get_v_flow_type(), ""));
+    }
+    if (entry == nullptr) {
+        std::cerr << "Error: No instance for " << mapped.get_p_type() << ", "
+                  << mapped.get_v_type() << ", " << mapped.get_v_flow_type()
+                  << ". Built instances:\n";
+        for (auto&& e : instance_table) {
+            std::cerr << "  " << e.p_type << ", " << e.v_type << ", " << e.v_flow_type
+                      << (e.size.empty() ? "" : ", ") << e.size << '\n';
+        }
+        return 1;
+    }
+    return entry->run(parsed, mapped);
+#else
+    int status = 1;
+    mapped.map_instance([&]<typename SimType> {
+        status = run_instance<SimType>(parsed, mapped);
+    });
+    return status;
+#endif
 }
 
 int main(int argc, char** argv) {
     auto parsed = parse_arguments(argc, argv);
+    if (parsed.pin_cpus.has_value()) {
+        Fluid::WorkerPool::shared().pin(parsed.pin_cpus.value());
+    }
     // auto parsed = Parsed{.p_type="FAST_FIXED(32,16)", .v_type="FAST_FIXED(32,16)", .v_flow_type="FAST_FIXED(32,16)", .field_path="../base_field", .num_threads=3};
     Mapper mapped;
-    if (parsed.type == Parsed::Type::LOAD_SAVE) {
-        mapped = Mapper{ parsed.load_path };
-    } else {
-        mapped = Mapper{ parsed.p_type, parsed.v_type, parsed.v_flow_type,
-                         parsed.field_path };
-    }
+    try {
+        if (parsed.type == Parsed::Type::BATCH) {
+            // Scenarios leave out what the command line sets for all of them.
+            Fluid::Scenario defaults;
+            defaults.seed           = parsed.seed;
+            defaults.ticks          = parsed.ticks;
+            defaults.output         = parsed.output;
+            defaults.rng_mode       = parsed.rng_mode;
+            defaults.flow_solver    = parsed.flow_solver;
+            defaults.rest_threshold = parsed.rest_threshold;
 
-    mapped.map_instance([&]<typename SimType> {
-        SimType sim(mapped.get_rows(), mapped.get_cols(),
-                    parsed.num_threads.has_value() ? parsed.num_threads.value() : 1);
-        if (parsed.type == Parsed::Type::LOAD_SAVE) {
-            std::ifstream file(parsed.load_path);
-            assert(file.is_open());
-            file.ignore(std::numeric_limits<std::streamsize>::max(),
-                        file.widen('\n'));
-            sim.deserialize(file);
+            parsed.manifest = Fluid::Manifest::read(parsed.batch_path, defaults);
+            auto&& manifest = parsed.manifest;
+            mapped = Mapper{ manifest.p_type, manifest.v_type, manifest.v_flow_type,
+                             manifest.field_path };
+        } else if (parsed.type == Parsed::Type::LOAD_SAVE) {
+            mapped = Mapper{ parsed.load_path };
         } else {
-            sim.read_field(parsed.field_path);
+            mapped = Mapper{ parsed.p_type, parsed.v_type, parsed.v_flow_type,
+                             parsed.field_path };
         }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
 
-        std::signal(SIGINT, signal_handler);
-
-        shutdown_handler = [&](int signal) {
-            if (signal == SIGINT) {
-                std::ofstream file("save_" + std::to_string(sim.get_tick()));
-                assert(file.is_open());
-
-                file << mapped.get_p_type() << " " << mapped.get_v_type() << " "
-                     << mapped.get_v_flow_type() << " " << mapped.get_rows() << " "
-                     << mapped.get_cols() << std::endl;
-                sim.serialize(file);
-                std::cout << "Simulation saved to "
-                          << "save_" << sim.get_tick() << std::endl;
-                sleep(1);
-            }
-        };
-
-        sim.run();
-    });
-
-    return 0;
+    return dispatch(parsed, mapped);
 }
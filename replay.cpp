@@ -0,0 +1,201 @@
+#include "include/Trajectory.hpp"
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+
+// Reads a trajectory written by Fluid --trajectory. Without --tick prints
+// what the file holds; with it renders the field at that tick (up to --to)
+// as Fluid prints frames, or exports every recorded stream as JSON.
+
+namespace {
+
+using Name = std::array<char, Fluid::TrajectoryHeader::NAME_SIZE>;
+
+std::string type_name(const Name& name) {
+    return name.data();
+}
+
+template <typename T>
+T load(const std::byte* data) {
+    T v;
+    std::memcpy(&v, data, sizeof(v));
+    return v;
+}
+
+// Reads one value of a type named as on the Fluid command line.
+double decode(std::string_view type, const std::byte* data, size_t size) {
+    if (type == "DOUBLE") {
+        return load<double>(data);
+    }
+    if (type == "FLOAT") {
+        return load<float>(data);
+    }
+    auto comma = type.find(',');
+    if (!type.ends_with(")") || comma == std::string_view::npos) {
+        throw std::runtime_error("Unknown type: " + std::string{ type });
+    }
+    int k = std::stoi(std::string{ type.substr(comma + 1) });
+    int64_t raw = 0;
+    if (size == 1) {
+        raw = load<int8_t>(data);
+    } else if (size == 2) {
+        raw = load<int16_t>(data);
+    } else if (size == 4) {
+        raw = load<int32_t>(data);
+    } else if (size == 8) {
+        raw = load<int64_t>(data);
+    } else {
+        throw std::runtime_error("Unsupported value size for " +
+                                 std::string{ type });
+    }
+    return static_cast<double>(raw) / static_cast<double>(int64_t{ 1 } << k);
+}
+
+void render(std::ostream& out, const Fluid::TrajectoryHeader& header,
+            const Fluid::TrajectoryReader::State& state) {
+    std::string text = "Tick " + std::to_string(state.tick) + ":\n";
+    auto* cells      = reinterpret_cast<const char*>(state.cells[0].data());
+    for (size_t x = 0; x < header.rows; ++x) {
+        text.append(cells + x * header.cols, header.cols);
+        text += '\n';
+    }
+    out.write(text.data(), text.size());
+}
+
+nlohmann::json to_json(const Fluid::TrajectoryHeader& header,
+                       const Fluid::TrajectoryReader::State& state) {
+    nlohmann::json json;
+    json["tick"] = state.tick;
+    json["rows"] = header.rows;
+    json["cols"] = header.cols;
+    auto* cells  = reinterpret_cast<const char*>(state.cells[0].data());
+    for (size_t x = 0; x < header.rows; ++x) {
+        json["field"].push_back(std::string(cells + x * header.cols, header.cols));
+    }
+
+    size_t stream = 1;
+    if (header.streams & Fluid::TRAJECTORY_P) {
+        auto type = type_name(header.p_type);
+        auto&& p  = state.cells[stream++];
+        for (size_t x = 0; x < header.rows; ++x) {
+            nlohmann::json row = nlohmann::json::array();
+            for (size_t y = 0; y < header.cols; ++y) {
+                size_t i = x * header.cols + y;
+                row.push_back(decode(type, &p[i * header.p_size], header.p_size));
+            }
+            json["p"].push_back(std::move(row));
+        }
+    }
+    if (header.streams & Fluid::TRAJECTORY_VELOCITY) {
+        auto type    = type_name(header.v_type);
+        auto&& v     = state.cells[stream++];
+        size_t value = header.velocity_size / 4;
+        for (size_t x = 0; x < header.rows; ++x) {
+            nlohmann::json row = nlohmann::json::array();
+            for (size_t y = 0; y < header.cols; ++y) {
+                size_t i              = x * header.cols + y;
+                const std::byte* cell = &v[i * header.velocity_size];
+                nlohmann::json dirs   = nlohmann::json::array();
+                for (size_t d = 0; d < 4; ++d) {
+                    dirs.push_back(decode(type, cell + d * value, value));
+                }
+                row.push_back(std::move(dirs));
+            }
+            json["velocity"].push_back(std::move(row));
+        }
+    }
+    return json;
+}
+
+void summary(const Fluid::TrajectoryReader& reader) {
+    auto&& header  = reader.header();
+    auto&& entries = reader.entries();
+    size_t keys    = 0;
+    for (auto&& e : entries) {
+        keys += e.keyframe;
+    }
+    bool p        = header.streams & Fluid::TRAJECTORY_P;
+    bool velocity = header.streams & Fluid::TRAJECTORY_VELOCITY;
+    std::cout << "Field: " << header.rows << "x" << header.cols << '\n'
+              << "Types: " << type_name(header.p_type) << ", "
+              << type_name(header.v_type) << ", " << type_name(header.v_flow_type)
+              << '\n'
+              << "Streams: field" << (p ? ", p" : "")
+              << (velocity ? ", velocity" : "") << '\n'
+              << "Records: " << entries.size() << ", keyframes: " << keys << '\n';
+    if (!entries.empty()) {
+        std::cout << "Ticks: " << entries.front().tick << ".."
+                  << entries.back().tick << '\n';
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    cxxopts::Options options("fluid_replay",
+                             "Render or export a Fluid trajectory");
+    options.add_options()("h,help", "Display help")(
+        "trajectory", "Trajectory file", cxxopts::value<std::string>())(
+        "tick", "Tick to render or export", cxxopts::value<size_t>())(
+        "to", "Last tick of a range starting at --tick", cxxopts::value<size_t>())(
+        "format", "ascii (frames as Fluid prints them) or json",
+        cxxopts::value<std::string>()->default_value("ascii"))(
+        "out", "Output file (default: stdout)", cxxopts::value<std::string>());
+
+    try {
+        auto result = options.parse(argc, argv);
+        if (result.count("help") || !result.count("trajectory")) {
+            std::cout << options.help() << '\n';
+            return result.count("help") ? 0 : 1;
+        }
+        auto format = result["format"].as<std::string>();
+        if (format != "ascii" && format != "json") {
+            throw std::runtime_error("Unknown format: " + format);
+        }
+
+        Fluid::TrajectoryReader reader{ result["trajectory"].as<std::string>() };
+        if (!result.count("tick")) {
+            summary(reader);
+            return 0;
+        }
+
+        std::ofstream file;
+        if (result.count("out")) {
+            file.open(result["out"].as<std::string>(), std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Cannot open the output file");
+            }
+        }
+        std::ostream& out = result.count("out") ? file : std::cout;
+
+        size_t first   = result["tick"].as<size_t>();
+        size_t last    = result.count("to") ? result["to"].as<size_t>() : first;
+        auto&& entries = reader.entries();
+        auto state     = reader.seek(first);
+        auto frames    = nlohmann::json::array();
+        for (size_t i = reader.find(first);;) {
+            if (format == "ascii") {
+                render(out, reader.header(), state);
+            } else {
+                frames.push_back(to_json(reader.header(), state));
+            }
+            if (++i == entries.size() || entries[i].tick > last) {
+                break;
+            }
+            reader.apply(state, i);
+        }
+        if (format == "json") {
+            out << (frames.size() == 1 ? frames[0] : frames).dump() << '\n';
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("Failed to write the output");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
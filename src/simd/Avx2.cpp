@@ -0,0 +1,309 @@
+// Compiled with -mavx2, only called after the CPU check in Simd.hpp.
+#define FLUID_SIMD_NS avx2
+#include "Kernels.hpp"
+#include <cstring>
+#include <immintrin.h>
+
+namespace Fluid::simd::avx2 {
+
+static_assert(sizeof(int) == sizeof(int32_t));
+
+// Eight mask bytes widened to one all-ones/zero 32-bit lane each.
+inline __m256i bytes_has_bits(const uint8_t* ptr, uint8_t bits) {
+    __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)ptr));
+    __m256i m = _mm256_set1_epi32(bits);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(b, m), m);
+}
+
+inline __m256i bytes_eq(const char* ptr, char c) {
+    __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)ptr));
+    return _mm256_cmpeq_epi32(b, _mm256_set1_epi32(static_cast<uint8_t>(c)));
+}
+
+// Four mask bytes widened to 64-bit lanes.
+inline __m256i bytes_has_bits_64(const uint8_t* ptr, uint8_t bits) {
+    int32_t raw;
+    std::memcpy(&raw, ptr, sizeof(raw));
+    __m256i b = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(raw));
+    __m256i m = _mm256_set1_epi64x(bits);
+    return _mm256_cmpeq_epi64(_mm256_and_si256(b, m), m);
+}
+
+inline __m256i bytes_eq_64(const char* ptr, char c) {
+    int32_t raw;
+    std::memcpy(&raw, ptr, sizeof(raw));
+    __m256i b = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(raw));
+    return _mm256_cmpeq_epi64(b, _mm256_set1_epi64x(static_cast<uint8_t>(c)));
+}
+
+template <>
+struct Ops<int32_t> {
+    using V = __m256i;
+    using M = __m256i;
+    using D = __m256i;
+
+    static constexpr size_t width = 8;
+
+    static V load(const int32_t* ptr) {
+        return _mm256_loadu_si256((const __m256i*)ptr);
+    }
+
+    static void store(int32_t* ptr, V v) {
+        _mm256_storeu_si256((__m256i*)ptr, v);
+    }
+
+    static V set1(int32_t v) {
+        return _mm256_set1_epi32(v);
+    }
+
+    static V zero() {
+        return _mm256_setzero_si256();
+    }
+
+    static V none() {
+        return zero();
+    }
+
+    static M gt_zero(V v) {
+        return _mm256_cmpgt_epi32(v, zero());
+    }
+
+    static bool any(M m) {
+        return !_mm256_testz_si256(m, m);
+    }
+
+    static M mask_and(M a, M b) {
+        return _mm256_and_si256(a, b);
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return bytes_has_bits(ptr, bits);
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return bytes_eq(ptr, c);
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return _mm256_blendv_epi8(if_false, if_true, m);
+    }
+
+    static V add(V a, V b) {
+        return _mm256_add_epi32(a, b);
+    }
+
+    static V sub(V a, V b) {
+        return _mm256_sub_epi32(a, b);
+    }
+
+    // Bits [shift, shift + 32) of the 64-bit products, as Fixed::operator*=.
+    static V mul(V a, V b, unsigned shift) {
+        __m128i s    = _mm_cvtsi32_si128(static_cast<int>(shift));
+        __m256i even = _mm256_srl_epi64(_mm256_mul_epi32(a, b), s);
+        __m256i odd  = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                                        _mm256_srli_epi64(b, 32));
+        odd = _mm256_slli_epi64(_mm256_srl_epi64(odd, s), 32);
+        return _mm256_blend_epi32(even, odd, 0xAA);
+    }
+
+    static V scale(V a, int32_t f, unsigned shift) {
+        return mul(a, set1(f), shift);
+    }
+
+    static D load_dirs(const int* ptr) {
+        return load(ptr);
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return _mm256_blendv_epi8(if_false, if_true, m);
+    }
+
+    // Every int32 is exact in a double and the quotient by 1..4 is never
+    // close enough to an integer to round across it, so truncating the
+    // double quotient gives the integer division.
+    static V div(V a, D d, M m) {
+        d          = _mm256_blendv_epi8(_mm256_set1_epi32(1), d, m);
+        __m256d lo = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+                                   _mm256_cvtepi32_pd(_mm256_castsi256_si128(d)));
+        __m256d hi =
+            _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+                          _mm256_cvtepi32_pd(_mm256_extracti128_si256(d, 1)));
+        __m256i q =
+            _mm256_set_m128i(_mm256_cvttpd_epi32(hi), _mm256_cvttpd_epi32(lo));
+        return _mm256_and_si256(q, m);
+    }
+};
+
+template <>
+struct Ops<float> {
+    using V = __m256;
+    using M = __m256;
+    using D = __m256;
+
+    static constexpr size_t width = 8;
+
+    static V load(const float* ptr) {
+        return _mm256_loadu_ps(ptr);
+    }
+
+    static void store(float* ptr, V v) {
+        _mm256_storeu_ps(ptr, v);
+    }
+
+    static V set1(float v) {
+        return _mm256_set1_ps(v);
+    }
+
+    static V zero() {
+        return _mm256_setzero_ps();
+    }
+
+    static V none() {
+        return set1(-0.0f);
+    }
+
+    static M gt_zero(V v) {
+        return _mm256_cmp_ps(v, zero(), _CMP_GT_OQ);
+    }
+
+    static bool any(M m) {
+        return _mm256_movemask_ps(m) != 0;
+    }
+
+    static M mask_and(M a, M b) {
+        return _mm256_and_ps(a, b);
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return _mm256_castsi256_ps(bytes_has_bits(ptr, bits));
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return _mm256_castsi256_ps(bytes_eq(ptr, c));
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return _mm256_blendv_ps(if_false, if_true, m);
+    }
+
+    static V add(V a, V b) {
+        return _mm256_add_ps(a, b);
+    }
+
+    static V sub(V a, V b) {
+        return _mm256_sub_ps(a, b);
+    }
+
+    static V mul(V a, V b, unsigned) {
+        return _mm256_mul_ps(a, b);
+    }
+
+    // Widened to double and rounded back, as `float *= double`.
+    static V scale(V a, double f, unsigned) {
+        __m256d fv = _mm256_set1_pd(f);
+        __m256d lo = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(a)), fv);
+        __m256d hi = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)), fv);
+        return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo));
+    }
+
+    static D load_dirs(const int* ptr) {
+        return _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)ptr));
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return _mm256_blendv_ps(if_false, if_true, m);
+    }
+
+    static V div(V a, D d, M m) {
+        V q = _mm256_div_ps(a, _mm256_blendv_ps(set1(1), d, m));
+        return _mm256_blendv_ps(none(), q, m);
+    }
+};
+
+template <>
+struct Ops<double> {
+    using V = __m256d;
+    using M = __m256d;
+    using D = __m256d;
+
+    static constexpr size_t width = 4;
+
+    static V load(const double* ptr) {
+        return _mm256_loadu_pd(ptr);
+    }
+
+    static void store(double* ptr, V v) {
+        _mm256_storeu_pd(ptr, v);
+    }
+
+    static V set1(double v) {
+        return _mm256_set1_pd(v);
+    }
+
+    static V zero() {
+        return _mm256_setzero_pd();
+    }
+
+    static V none() {
+        return set1(-0.0);
+    }
+
+    static M gt_zero(V v) {
+        return _mm256_cmp_pd(v, zero(), _CMP_GT_OQ);
+    }
+
+    static bool any(M m) {
+        return _mm256_movemask_pd(m) != 0;
+    }
+
+    static M mask_and(M a, M b) {
+        return _mm256_and_pd(a, b);
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return _mm256_castsi256_pd(bytes_has_bits_64(ptr, bits));
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return _mm256_castsi256_pd(bytes_eq_64(ptr, c));
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return _mm256_blendv_pd(if_false, if_true, m);
+    }
+
+    static V add(V a, V b) {
+        return _mm256_add_pd(a, b);
+    }
+
+    static V sub(V a, V b) {
+        return _mm256_sub_pd(a, b);
+    }
+
+    static V mul(V a, V b, unsigned) {
+        return _mm256_mul_pd(a, b);
+    }
+
+    static V scale(V a, double f, unsigned) {
+        return _mm256_mul_pd(a, set1(f));
+    }
+
+    static D load_dirs(const int* ptr) {
+        return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)ptr));
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return _mm256_blendv_pd(if_false, if_true, m);
+    }
+
+    static V div(V a, D d, M m) {
+        V q = _mm256_div_pd(a, _mm256_blendv_pd(set1(1), d, m));
+        return _mm256_blendv_pd(none(), q, m);
+    }
+};
+
+} // namespace Fluid::simd::avx2
+
+FLUID_SIMD_INSTANTIATE(float)
+FLUID_SIMD_INSTANTIATE(double)
+FLUID_SIMD_INSTANTIATE(int32_t)
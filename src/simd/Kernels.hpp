@@ -0,0 +1,307 @@
+#pragma once
+
+// Generic bodies of the vector kernels. Every instruction set translation
+// unit defines FLUID_SIMD_NS before including this file, so each one gets
+// its own copy compiled with its own target flags.
+//
+// An Ops type provides lane-wise operations on `width` values of R:
+// fixed-point lanes (R = int32_t) multiply as (a * b) >> shift and divide
+// by the integer direction counts with truncation, exactly like Fixed.
+// `none()` is the identity of add: 0 for integers, -0.0 for floating
+// point, so lanes without a contribution leave p bit-for-bit unchanged.
+
+#include "Simd.hpp"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#ifndef FLUID_SIMD_NS
+#error "FLUID_SIMD_NS must name the instruction set namespace"
+#endif
+
+namespace Fluid::simd::FLUID_SIMD_NS {
+
+// Vector operations of this instruction set, defined by the including file.
+template <typename R>
+struct Ops;
+
+template <typename R>
+struct ScalarOps {
+    using V = R;
+    using M = bool;
+    using D = int;
+
+    static constexpr size_t width = 1;
+
+    static V load(const R* ptr) {
+        return *ptr;
+    }
+
+    static void store(R* ptr, V v) {
+        *ptr = v;
+    }
+
+    static V set1(R v) {
+        return v;
+    }
+
+    static V none() {
+        return -R{};
+    }
+
+    static M gt_zero(V v) {
+        return v > 0;
+    }
+
+    static bool any(M m) {
+        return m;
+    }
+
+    static M mask_and(M a, M b) {
+        return a && b;
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return (*ptr & bits) == bits;
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return *ptr == c;
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return m ? if_true : if_false;
+    }
+
+    static V add(V a, V b) {
+        return a + b;
+    }
+
+    static V sub(V a, V b) {
+        return a - b;
+    }
+
+    static V mul(V a, V b, unsigned shift) {
+        if constexpr (std::is_integral_v<R>) {
+            return static_cast<R>((static_cast<int64_t>(a) * b) >> shift);
+        } else {
+            return a * b;
+        }
+    }
+
+    // Float lanes are scaled in double precision, as `float *= double`.
+    static V scale(V a, Factor<R> f, unsigned shift) {
+        if constexpr (std::is_integral_v<R>) {
+            return mul(a, f, shift);
+        } else {
+            return static_cast<R>(a * f);
+        }
+    }
+
+    static D load_dirs(const int* ptr) {
+        return *ptr;
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return m ? if_true : if_false;
+    }
+
+    // a / d in the lanes set in `m`, none() elsewhere.
+    static V div(V a, D d, M m) {
+        if (!m) {
+            return none();
+        }
+        if constexpr (std::is_integral_v<R>) {
+            return a / d;
+        } else {
+            return a / static_cast<R>(d);
+        }
+    }
+};
+
+template <typename Ops, typename R>
+size_t external_forces_span(const Cells<R>& c, size_t x, size_t y, size_t y1) {
+    constexpr size_t down  = 0;
+    constexpr uint8_t bits = OPEN_SELF | open_bit(down);
+
+    R* v                = c.velocity[down] + x * c.velocity_stride;
+    const uint8_t* open = c.open + x * c.open_stride;
+    auto g              = Ops::set1(c.g);
+
+    for (; y + Ops::width <= y1; y += Ops::width) {
+        auto m   = Ops::has_bits(open + y, bits);
+        auto cur = Ops::load(v + y);
+        Ops::store(v + y, Ops::select(m, cur, Ops::add(cur, g)));
+    }
+    return y;
+}
+
+// Per-row pressure contributions of recalc_p, indexed by column. `nb(d, y)`
+// is what cell y hands to its neighbour in direction d, `self(d, y)` what it
+// keeps because that neighbour is a wall. Two columns pad each side; column
+// y is stored at y + PAD - y0, which is never negative for y >= y0 - PAD.
+template <typename R>
+struct RowContributions {
+    static constexpr size_t PAD = 2;
+
+    void reset(size_t y0, size_t y1) {
+        first = y0;
+        width = y1 - y0 + 2 * PAD;
+        storage.assign(2 * dir_offsets.size() * width, ScalarOps<R>::none());
+    }
+
+    R* nb(size_t d, size_t y) {
+        return storage.data() + (2 * d) * width + y + PAD - first;
+    }
+
+    const R* nb(size_t d, size_t y) const {
+        return storage.data() + (2 * d) * width + y + PAD - first;
+    }
+
+    R* self(size_t d, size_t y) {
+        return storage.data() + (2 * d + 1) * width + y + PAD - first;
+    }
+
+    const R* self(size_t d, size_t y) const {
+        return storage.data() + (2 * d + 1) * width + y + PAD - first;
+    }
+
+    std::vector<R> storage;
+    size_t first = 0;
+    size_t width = 0;
+};
+
+// First pass: updates velocity and computes what every cell of the row
+// hands out, with the same operations as the scalar loop.
+template <typename Ops, typename R>
+size_t recalc_p_span(const Cells<R>& c, size_t x, size_t y, size_t y1,
+                     RowContributions<R>& out) {
+    const char* field   = c.field + x * c.field_stride;
+    const uint8_t* open = c.open + x * c.open_stride;
+    const int* dirs     = c.dirs + x * c.dirs_stride;
+
+    auto rho_air   = Ops::set1(c.rho_air);
+    auto rho_water = Ops::set1(c.rho_water);
+
+    for (; y + Ops::width <= y1; y += Ops::width) {
+        auto self  = Ops::has_bits(open + y, OPEN_SELF);
+        auto water = Ops::is_char(field + y, '.');
+        auto rho   = Ops::select(water, rho_air, rho_water);
+
+        for (size_t d = 0; d < dir_offsets.size(); ++d) {
+            auto [dx, dy] = dir_offsets[d];
+
+            R* vel     = c.velocity[d] + x * c.velocity_stride + y;
+            auto old_v = Ops::load(vel);
+            auto moved = Ops::mask_and(Ops::gt_zero(old_v), self);
+            if (!Ops::any(moved)) {
+                Ops::store(out.nb(d, y), Ops::none());
+                Ops::store(out.self(d, y), Ops::none());
+                continue;
+            }
+            auto new_v = Ops::load(c.velocity_flow[d] + x * c.flow_stride + y);
+            Ops::store(vel, Ops::select(moved, old_v, new_v));
+
+            auto force = Ops::mul(Ops::sub(old_v, new_v), rho, c.shift);
+            force      = Ops::select(water, force,
+                                     Ops::scale(force, c.water_factor, c.shift));
+
+            const int* nb_dirs =
+                dirs + y + dx * static_cast<ptrdiff_t>(c.dirs_stride) + dy;
+            auto nb_open = Ops::has_bits(open + y, open_bit(d));
+            auto div_by  = Ops::select_dirs(nb_open, Ops::load_dirs(dirs + y),
+                                            Ops::load_dirs(nb_dirs));
+            auto part    = Ops::div(force, div_by, moved);
+
+            Ops::store(out.nb(d, y), Ops::select(nb_open, Ops::none(), part));
+            Ops::store(out.self(d, y), Ops::select(nb_open, part, Ops::none()));
+        }
+    }
+    return y;
+}
+
+// Second pass over the cells of row x that receive pressure from it. The
+// additions follow the scalar scan order (left neighbour, the cell itself
+// in `deltas` order, right neighbour), so floating point sums round the
+// same way. Contributions are read with shifted loads instead of storing
+// to p at shifted offsets, which would stall on store-to-load forwarding.
+template <typename Ops, typename R>
+size_t gather_row_span(R* p, const RowContributions<R>& in, size_t y, size_t y1) {
+    constexpr size_t down  = 0;
+    constexpr size_t up    = 1;
+    constexpr size_t right = 2;
+    constexpr size_t left  = 3;
+
+    for (; y + Ops::width <= y1; y += Ops::width) {
+        auto sum = Ops::add(Ops::load(p + y), Ops::load(in.nb(right, y - 1)));
+        sum      = Ops::add(sum, Ops::load(in.self(up, y)));
+        sum      = Ops::add(sum, Ops::load(in.self(down, y)));
+        sum      = Ops::add(sum, Ops::load(in.self(left, y)));
+        sum      = Ops::add(sum, Ops::load(in.self(right, y)));
+        sum      = Ops::add(sum, Ops::load(in.nb(left, y + 1)));
+        Ops::store(p + y, sum);
+    }
+    return y;
+}
+
+// Adds what row x hands to the row in direction d.
+template <typename Ops, typename R>
+size_t add_span(R* p, const RowContributions<R>& in, size_t d, size_t y, size_t y1) {
+    for (; y + Ops::width <= y1; y += Ops::width) {
+        Ops::store(p + y, Ops::add(Ops::load(p + y), Ops::load(in.nb(d, y))));
+    }
+    return y;
+}
+
+template <typename Ops, typename R>
+void apply_external_forces_region(const Cells<R>& c, Region r) {
+    for (size_t x = r.x0; x < r.x1; ++x) {
+        size_t y = external_forces_span<Ops>(c, x, r.y0, r.y1);
+        external_forces_span<ScalarOps<R>>(c, x, y, r.y1);
+    }
+}
+
+// Row x - 1 has received everything else before row x hands pressure up,
+// and row x + 1 gets row x's share before its own.
+template <typename Ops, typename R>
+void recalc_p_region(const Cells<R>& c, Region r) {
+    constexpr size_t down = 0;
+    constexpr size_t up   = 1;
+
+    thread_local RowContributions<R> row;
+    row.reset(r.y0, r.y1);
+    for (size_t x = r.x0; x < r.x1; ++x) {
+        size_t y = recalc_p_span<Ops>(c, x, r.y0, r.y1, row);
+        recalc_p_span<ScalarOps<R>>(c, x, y, r.y1, row);
+
+        R* above = c.p + (x - 1) * c.p_stride;
+        y        = add_span<Ops>(above, row, up, r.y0, r.y1);
+        add_span<ScalarOps<R>>(above, row, up, y, r.y1);
+
+        R* p = c.p + x * c.p_stride;
+        y    = gather_row_span<Ops>(p, row, r.y0 - 1, r.y1 + 1);
+        gather_row_span<ScalarOps<R>>(p, row, y, r.y1 + 1);
+
+        R* below = c.p + (x + 1) * c.p_stride;
+        y        = add_span<Ops>(below, row, down, r.y0, r.y1);
+        add_span<ScalarOps<R>>(below, row, down, y, r.y1);
+    }
+}
+
+template <typename R>
+void apply_external_forces(const Cells<R>& cells, Region region) {
+    apply_external_forces_region<Ops<R>>(cells, region);
+}
+
+template <typename R>
+void recalc_p(const Cells<R>& cells, Region region) {
+    recalc_p_region<Ops<R>>(cells, region);
+}
+
+} // namespace Fluid::simd::FLUID_SIMD_NS
+
+// Instantiates the entry points for lane type R once Ops<R> is complete.
+#define FLUID_SIMD_INSTANTIATE(R)                                                 \
+    template void Fluid::simd::FLUID_SIMD_NS::apply_external_forces<R>(           \
+        const Cells<R>&, Region);                                                 \
+    template void Fluid::simd::FLUID_SIMD_NS::recalc_p<R>(const Cells<R>&, Region);
@@ -0,0 +1,13 @@
+#define FLUID_SIMD_NS scalar
+#include "Kernels.hpp"
+
+namespace Fluid::simd::scalar {
+
+template <typename R>
+struct Ops : ScalarOps<R> {};
+
+} // namespace Fluid::simd::scalar
+
+FLUID_SIMD_INSTANTIATE(float)
+FLUID_SIMD_INSTANTIATE(double)
+FLUID_SIMD_INSTANTIATE(int32_t)
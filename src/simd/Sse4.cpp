@@ -0,0 +1,305 @@
+// Compiled with -msse4.1, only called after the CPU check in Simd.hpp.
+#define FLUID_SIMD_NS sse4
+#include "Kernels.hpp"
+#include <cstring>
+#include <immintrin.h>
+
+namespace Fluid::simd::sse4 {
+
+static_assert(sizeof(int) == sizeof(int32_t));
+
+inline __m128i load_bytes(const void* ptr, size_t n) {
+    int32_t raw = 0;
+    std::memcpy(&raw, ptr, n);
+    return _mm_cvtsi32_si128(raw);
+}
+
+// Four mask bytes widened to one all-ones/zero 32-bit lane each.
+inline __m128i bytes_has_bits(const uint8_t* ptr, uint8_t bits) {
+    __m128i b = _mm_cvtepu8_epi32(load_bytes(ptr, 4));
+    __m128i m = _mm_set1_epi32(bits);
+    return _mm_cmpeq_epi32(_mm_and_si128(b, m), m);
+}
+
+inline __m128i bytes_eq(const char* ptr, char c) {
+    __m128i b = _mm_cvtepu8_epi32(load_bytes(ptr, 4));
+    return _mm_cmpeq_epi32(b, _mm_set1_epi32(static_cast<uint8_t>(c)));
+}
+
+// Two mask bytes widened to 64-bit lanes.
+inline __m128i bytes_has_bits_64(const uint8_t* ptr, uint8_t bits) {
+    __m128i b = _mm_cvtepu8_epi64(load_bytes(ptr, 2));
+    __m128i m = _mm_set1_epi64x(bits);
+    return _mm_cmpeq_epi64(_mm_and_si128(b, m), m);
+}
+
+inline __m128i bytes_eq_64(const char* ptr, char c) {
+    __m128i b = _mm_cvtepu8_epi64(load_bytes(ptr, 2));
+    return _mm_cmpeq_epi64(b, _mm_set1_epi64x(static_cast<uint8_t>(c)));
+}
+
+template <>
+struct Ops<int32_t> {
+    using V = __m128i;
+    using M = __m128i;
+    using D = __m128i;
+
+    static constexpr size_t width = 4;
+
+    static V load(const int32_t* ptr) {
+        return _mm_loadu_si128((const __m128i*)ptr);
+    }
+
+    static void store(int32_t* ptr, V v) {
+        _mm_storeu_si128((__m128i*)ptr, v);
+    }
+
+    static V set1(int32_t v) {
+        return _mm_set1_epi32(v);
+    }
+
+    static V zero() {
+        return _mm_setzero_si128();
+    }
+
+    static V none() {
+        return zero();
+    }
+
+    static M gt_zero(V v) {
+        return _mm_cmpgt_epi32(v, zero());
+    }
+
+    static bool any(M m) {
+        return _mm_movemask_epi8(m) != 0;
+    }
+
+    static M mask_and(M a, M b) {
+        return _mm_and_si128(a, b);
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return bytes_has_bits(ptr, bits);
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return bytes_eq(ptr, c);
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return _mm_blendv_epi8(if_false, if_true, m);
+    }
+
+    static V add(V a, V b) {
+        return _mm_add_epi32(a, b);
+    }
+
+    static V sub(V a, V b) {
+        return _mm_sub_epi32(a, b);
+    }
+
+    // Bits [shift, shift + 32) of the 64-bit products, as Fixed::operator*=.
+    static V mul(V a, V b, unsigned shift) {
+        __m128i s    = _mm_cvtsi32_si128(static_cast<int>(shift));
+        __m128i even = _mm_srl_epi64(_mm_mul_epi32(a, b), s);
+        __m128i odd  = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        odd = _mm_slli_epi64(_mm_srl_epi64(odd, s), 32);
+        return _mm_blend_epi16(even, odd, 0xCC);
+    }
+
+    static V scale(V a, int32_t f, unsigned shift) {
+        return mul(a, set1(f), shift);
+    }
+
+    static D load_dirs(const int* ptr) {
+        return load(ptr);
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return _mm_blendv_epi8(if_false, if_true, m);
+    }
+
+    // Exact for the same reason as the AVX2 version.
+    static V div(V a, D d, M m) {
+        d          = _mm_blendv_epi8(_mm_set1_epi32(1), d, m);
+        __m128d lo = _mm_div_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(d));
+        __m128d hi = _mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(a, 8)),
+                                _mm_cvtepi32_pd(_mm_srli_si128(d, 8)));
+        __m128i q  = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+        return _mm_and_si128(q, m);
+    }
+};
+
+template <>
+struct Ops<float> {
+    using V = __m128;
+    using M = __m128;
+    using D = __m128;
+
+    static constexpr size_t width = 4;
+
+    static V load(const float* ptr) {
+        return _mm_loadu_ps(ptr);
+    }
+
+    static void store(float* ptr, V v) {
+        _mm_storeu_ps(ptr, v);
+    }
+
+    static V set1(float v) {
+        return _mm_set1_ps(v);
+    }
+
+    static V zero() {
+        return _mm_setzero_ps();
+    }
+
+    static V none() {
+        return set1(-0.0f);
+    }
+
+    static M gt_zero(V v) {
+        return _mm_cmpgt_ps(v, zero());
+    }
+
+    static bool any(M m) {
+        return _mm_movemask_ps(m) != 0;
+    }
+
+    static M mask_and(M a, M b) {
+        return _mm_and_ps(a, b);
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return _mm_castsi128_ps(bytes_has_bits(ptr, bits));
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return _mm_castsi128_ps(bytes_eq(ptr, c));
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return _mm_blendv_ps(if_false, if_true, m);
+    }
+
+    static V add(V a, V b) {
+        return _mm_add_ps(a, b);
+    }
+
+    static V sub(V a, V b) {
+        return _mm_sub_ps(a, b);
+    }
+
+    static V mul(V a, V b, unsigned) {
+        return _mm_mul_ps(a, b);
+    }
+
+    // Widened to double and rounded back, as `float *= double`.
+    static V scale(V a, double f, unsigned) {
+        __m128d fv = _mm_set1_pd(f);
+        __m128d lo = _mm_mul_pd(_mm_cvtps_pd(a), fv);
+        __m128d hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)), fv);
+        return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+    }
+
+    static D load_dirs(const int* ptr) {
+        return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)ptr));
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return _mm_blendv_ps(if_false, if_true, m);
+    }
+
+    static V div(V a, D d, M m) {
+        V q = _mm_div_ps(a, _mm_blendv_ps(set1(1), d, m));
+        return _mm_blendv_ps(none(), q, m);
+    }
+};
+
+template <>
+struct Ops<double> {
+    using V = __m128d;
+    using M = __m128d;
+    using D = __m128d;
+
+    static constexpr size_t width = 2;
+
+    static V load(const double* ptr) {
+        return _mm_loadu_pd(ptr);
+    }
+
+    static void store(double* ptr, V v) {
+        _mm_storeu_pd(ptr, v);
+    }
+
+    static V set1(double v) {
+        return _mm_set1_pd(v);
+    }
+
+    static V zero() {
+        return _mm_setzero_pd();
+    }
+
+    static V none() {
+        return set1(-0.0);
+    }
+
+    static M gt_zero(V v) {
+        return _mm_cmpgt_pd(v, zero());
+    }
+
+    static bool any(M m) {
+        return _mm_movemask_pd(m) != 0;
+    }
+
+    static M mask_and(M a, M b) {
+        return _mm_and_pd(a, b);
+    }
+
+    static M has_bits(const uint8_t* ptr, uint8_t bits) {
+        return _mm_castsi128_pd(bytes_has_bits_64(ptr, bits));
+    }
+
+    static M is_char(const char* ptr, char c) {
+        return _mm_castsi128_pd(bytes_eq_64(ptr, c));
+    }
+
+    static V select(M m, V if_false, V if_true) {
+        return _mm_blendv_pd(if_false, if_true, m);
+    }
+
+    static V add(V a, V b) {
+        return _mm_add_pd(a, b);
+    }
+
+    static V sub(V a, V b) {
+        return _mm_sub_pd(a, b);
+    }
+
+    static V mul(V a, V b, unsigned) {
+        return _mm_mul_pd(a, b);
+    }
+
+    static V scale(V a, double f, unsigned) {
+        return _mm_mul_pd(a, set1(f));
+    }
+
+    static D load_dirs(const int* ptr) {
+        return _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)ptr));
+    }
+
+    static D select_dirs(M m, D if_false, D if_true) {
+        return _mm_blendv_pd(if_false, if_true, m);
+    }
+
+    static V div(V a, D d, M m) {
+        V q = _mm_div_pd(a, _mm_blendv_pd(set1(1), d, m));
+        return _mm_blendv_pd(none(), q, m);
+    }
+};
+
+} // namespace Fluid::simd::sse4
+
+FLUID_SIMD_INSTANTIATE(float)
+FLUID_SIMD_INSTANTIATE(double)
+FLUID_SIMD_INSTANTIATE(int32_t)